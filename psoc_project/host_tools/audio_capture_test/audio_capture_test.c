@@ -0,0 +1,229 @@
+/* Host test of the audio capture ring. ADC stand-in is fed with numbered
+ * samples, so every sample the application gets tells where it came from.
+ * Checks that blocks are returned in order and no sample is lost while
+ * the DMA completion IRQ waits, that windows are correct also when they wrap
+ * around the end of the ring and that overruns are counted without corrupting
+ * held blocks. Exit status is non-zero if any check fails */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "audio_capture.h"
+
+/* Window the application analyses, as with the largest FFT */
+#define TEST_WINDOW_SIZE        (FFT_MAX_SIZE)
+#define TEST_WINDOW_BLOCKS      (TEST_WINDOW_SIZE / AUDIO_CAPTURE_BLOCK_SIZE)
+
+/* Samples are numbered, number is wrapped to stay in the 16 bit sample range */
+#define TEST_SAMPLE(index)      ((int16_t)((index) & 0x7FFF))
+
+static cyhal_adc_t adc_obj;
+static cyhal_adc_channel_t adc_chan_obj;
+
+/* Number of the next sample fed to ADC */
+static uint32_t fed_samples = 0;
+
+static uint32_t failures = 0;
+
+static void feed_blocks(size_t count);
+static bool samples_match(const int16_t* samples, size_t length, uint32_t first);
+static bool window_matches(size_t length, uint32_t end, bool* wrapped);
+static void check(bool condition, const char* name);
+static void test_block_order(void);
+static void test_window_wrap(void);
+static void test_overrun(void);
+
+int main(void)
+{
+    if((CY_RSLT_SUCCESS != cyhal_adc_init(&adc_obj, NC, NULL)) ||
+       (CY_RSLT_SUCCESS != cyhal_adc_channel_init_diff(&adc_chan_obj, &adc_obj, NC, NC, NULL)))
+    {
+        fprintf(stderr, "ADC init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    if(audio_capture_success != audio_capture_init(&adc_chan_obj))
+    {
+        fprintf(stderr, "audio_capture_init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    if(audio_capture_success != audio_capture_start())
+    {
+        fprintf(stderr, "audio_capture_start failed\n");
+        return EXIT_FAILURE;
+    }
+
+    test_block_order();
+    test_window_wrap();
+    test_overrun();
+
+    if(0 != failures)
+    {
+        printf("audio capture test failed, %u checks failed\n", (unsigned)failures);
+        return EXIT_FAILURE;
+    }
+
+    printf("audio capture test passed\n");
+    return EXIT_SUCCESS;
+}
+
+/* Blocks come in the order they were filled. DMA moves to the next block by
+ * itself, so no sample is lost while the completion IRQ waits to be served */
+static void test_block_order(void)
+{
+    const size_t blocks = 3;
+    uint32_t first = fed_samples;
+    bool in_order = true;
+    int16_t* block;
+
+    cy_host_dma_set_irq_latency(AUDIO_CAPTURE_BLOCK_SIZE / 2);
+    feed_blocks(blocks);
+    cy_host_dma_set_irq_latency(0);
+
+    for(size_t i = 0; i < blocks; i++)
+    {
+        audio_capture_get_block(&block);
+        in_order &= samples_match(block, AUDIO_CAPTURE_BLOCK_SIZE, first + (i * AUDIO_CAPTURE_BLOCK_SIZE));
+    }
+    check(in_order, "blocks are returned in order");
+    check(0 == adc_obj.lost_samples, "no samples lost while IRQ is pending");
+
+    audio_capture_release_blocks(AUDIO_CAPTURE_BLOCK_SIZE);
+}
+
+/* Application loop of main.c, windows slide by one block through the ring
+ * several times, so some of them wrap around its end */
+static void test_window_wrap(void)
+{
+    const int16_t* head;
+    const int16_t* tail;
+    size_t head_length;
+    int16_t* block;
+    bool windows_match = true;
+    bool wrapped = false;
+    size_t windows = 0;
+
+    for(size_t i = 0; i < (3 * AUDIO_CAPTURE_BLOCKS); i++)
+    {
+        feed_blocks(1);
+        audio_capture_get_block(&block);
+
+        if(i < (TEST_WINDOW_BLOCKS - 1))
+        {
+            if(audio_capture_error_not_enough_samples !=
+               audio_capture_get_window(TEST_WINDOW_SIZE, &head, &head_length, &tail))
+            {
+                windows_match = false;
+            }
+            continue;
+        }
+
+        windows_match &= window_matches(TEST_WINDOW_SIZE, fed_samples, &wrapped);
+        windows++;
+        audio_capture_release_blocks(TEST_WINDOW_SIZE);
+    }
+
+    check(windows_match, "windows hold the latest samples");
+    check(wrapped, "windows wrap around the end of the ring");
+    check(0 != windows, "windows are analysed");
+}
+
+/* Application stops taking blocks until DMA catches up with the held window.
+ * Blocks filled after that are dropped, held ones stay intact */
+static void test_overrun(void)
+{
+    const uint32_t window_end = fed_samples;
+    const size_t free_blocks = AUDIO_CAPTURE_BLOCKS - TEST_WINDOW_BLOCKS;
+    const size_t fed_blocks = free_blocks + 4;
+    const uint32_t first = fed_samples;
+    bool in_order = true;
+    bool wrapped;
+    int16_t* block;
+
+    /* Blocks of the last window except the oldest one are still held */
+    check(0 == audio_capture_get_overruns(), "no overruns while application keeps up");
+
+    feed_blocks(fed_blocks);
+    check((fed_blocks - free_blocks) == audio_capture_get_overruns(), "overruns are counted");
+    check(window_matches(TEST_WINDOW_SIZE - AUDIO_CAPTURE_BLOCK_SIZE, window_end, &wrapped),
+          "held blocks are not overwritten");
+
+    /* Free blocks got consecutive samples before the ring became full */
+    for(size_t i = 0; i < free_blocks; i++)
+    {
+        audio_capture_get_block(&block);
+        in_order &= samples_match(block, AUDIO_CAPTURE_BLOCK_SIZE, first + (i * AUDIO_CAPTURE_BLOCK_SIZE));
+    }
+    check(in_order, "blocks filled before overrun are kept");
+    check(window_matches(TEST_WINDOW_SIZE, first + (free_blocks * AUDIO_CAPTURE_BLOCK_SIZE), &wrapped),
+          "window ends before dropped blocks");
+    audio_capture_release_blocks(TEST_WINDOW_SIZE);
+
+    /* Capture goes on after the dropped blocks */
+    feed_blocks(1);
+    audio_capture_get_block(&block);
+    check(samples_match(block, AUDIO_CAPTURE_BLOCK_SIZE, fed_samples - AUDIO_CAPTURE_BLOCK_SIZE),
+          "capture resumes after overrun");
+    check((fed_blocks - free_blocks) == audio_capture_get_overruns(), "overruns stop when ring has room");
+    audio_capture_release_blocks(TEST_WINDOW_SIZE);
+}
+
+/* Feeds whole blocks of numbered samples */
+static void feed_blocks(size_t count)
+{
+    int32_t samples[AUDIO_CAPTURE_BLOCK_SIZE];
+
+    for(size_t i = 0; i < count; i++)
+    {
+        for(size_t j = 0; j < AUDIO_CAPTURE_BLOCK_SIZE; j++)
+        {
+            samples[j] = TEST_SAMPLE(fed_samples + j);
+        }
+        cyhal_host_adc_feed(&adc_obj, samples, AUDIO_CAPTURE_BLOCK_SIZE);
+        fed_samples += AUDIO_CAPTURE_BLOCK_SIZE;
+    }
+}
+
+static bool samples_match(const int16_t* samples, size_t length, uint32_t first)
+{
+    for(size_t i = 0; i < length; i++)
+    {
+        if(TEST_SAMPLE(first + i) != samples[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Window of length samples is expected to end right before sample number end */
+static bool window_matches(size_t length, uint32_t end, bool* wrapped)
+{
+    const int16_t* head;
+    const int16_t* tail;
+    size_t head_length;
+    uint32_t first = end - length;
+
+    if(audio_capture_success != audio_capture_get_window(length, &head, &head_length, &tail))
+    {
+        return false;
+    }
+
+    *wrapped = (NULL != tail);
+    if(!samples_match(head, head_length, first))
+    {
+        return false;
+    }
+
+    return (NULL == tail) || samples_match(tail, length - head_length, first + head_length);
+}
+
+static void check(bool condition, const char* name)
+{
+    printf("%-48s %s\n", name, condition ? "ok" : "FAILED");
+    if(!condition)
+    {
+        failures++;
+    }
+}
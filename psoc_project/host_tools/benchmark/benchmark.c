@@ -0,0 +1,332 @@
+/* Host microbenchmark of the DSP and LED encoding hot paths.
+ * Every case is repeated BENCH_RUNS times after BENCH_WARMUP_RUNS warm-up
+ * runs, min, median and p99 durations are printed and written to CSV */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "app_config.h"
+#include "cyhal.h"
+#include "fft_wrapper.h"
+#include "audio_visualizer.h"
+#include "ws2812.h"
+#include "decimator.h"
+#include "sliding_dft.h"
+#include "beat_detector.h"
+
+/* BENCH_RUNS is set by the Makefile, e.g. make run BENCH_RUNS=100 */
+#ifndef BENCH_WARMUP_RUNS
+#define BENCH_WARMUP_RUNS       (20)
+#endif
+#ifndef BENCH_RUNS
+#define BENCH_RUNS              (500)
+#endif
+#define BENCH_TIMER_FREQUENCY   (1000000000u)
+#define BENCH_DEFAULT_CSV       ("benchmark.csv")
+
+typedef void (*bench_fn_t)(size_t param);
+
+typedef struct {
+    uint32_t min;
+    uint32_t median;
+    uint32_t p99;
+} bench_stats_t;
+
+static cyhal_timer_t timer_obj;
+
+/* Input signal and buffers shared by the cases */
+static int16_t input_signal[MAX_SUPPORTED_FFT_SIZE];
+static int32_t input_copy[MAX_SUPPORTED_FFT_SIZE];
+static fft_work_t fft_work[FFT_WORK_SIZE(MAX_SUPPORTED_FFT_SIZE)];
+static float fft_res[MAX_SUPPORTED_FFT_SIZE];
+static arm_rfft_fast_instance_f32 fft_f32_obj;
+static fft_instance_t* fft_plan;
+static fft_dc_tracker_t fft_dc_tracker;
+static float bass_res[BASS_FFT_SIZE];
+static decimator_t decimator;
+static sliding_dft_t sliding_dft;
+static beat_detector_t beat_detector;
+static beat_info_t beat;
+static size_t spectrum_size;
+static led_color_t colors[WS2812_LEDS_COUNT];
+static ws2812_ring_t ring;
+static uint8_t ring_pixels[WS2812_RING_SIZE(WS2812_LEDS_COUNT)];
+
+static void generate_signal(int16_t* res, size_t length);
+static int compare_durations(const void* a, const void* b);
+static bench_stats_t bench_run(FILE* csv, const char* name, size_t param, bench_fn_t setup, bench_fn_t run);
+
+static void setup_compute_rfft(size_t fft_size);
+static void run_compute_rfft(size_t fft_size);
+static void setup_compute_rfft_split(size_t fft_size);
+static void run_compute_rfft_split(size_t fft_size);
+static void setup_visualize_fft(size_t mode);
+static void run_visualize_fft(size_t mode);
+static void run_decimator_process(size_t block_size);
+static void run_sliding_dft_process(size_t block_size);
+static void run_beat_detector_process(size_t bins_count);
+static void run_ws2812_set_leds(size_t count);
+static void run_ws2812_set_led(size_t count);
+static void run_ws2812_ring(size_t count);
+static void run_ws2812_update(size_t count);
+
+int main(int argc, char** argv)
+{
+    const char* csv_path = (argc > 1) ? argv[1] : BENCH_DEFAULT_CSV;
+    FILE* csv = fopen(csv_path, "w");
+    if(NULL == csv)
+    {
+        fprintf(stderr, "Can't open %s\n", csv_path);
+        return EXIT_FAILURE;
+    }
+
+    cyhal_timer_init(&timer_obj, NC, NULL);
+    cyhal_timer_set_frequency(&timer_obj, BENCH_TIMER_FREQUENCY);
+
+    /* Strips are not connected anywhere on the host */
+    cyhal_gpio_t strip_pins[WS2812_STRIPS_COUNT];
+    for(size_t i = 0; i < WS2812_STRIPS_COUNT; i++)
+    {
+        strip_pins[i] = NC;
+    }
+
+    if(ws2812_success != ws2812_init(strip_pins))
+    {
+        fprintf(stderr, "ws2812_init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    if(ARM_MATH_SUCCESS != fft_plans_init())
+    {
+        fprintf(stderr, "fft_plans_init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    if(visualizer_success != visualize_init(AUDIO_SAMPLING_RATE))
+    {
+        fprintf(stderr, "visualize_init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    generate_signal(input_signal, MAX_SUPPORTED_FFT_SIZE);
+    for(size_t i = 0; i < WS2812_LEDS_COUNT; i++)
+    {
+        colors[i].r = i;
+        colors[i].g = i * 3;
+        colors[i].b = i * 7;
+    }
+
+    fprintf(csv, "case,param,runs,min_ns,median_ns,p99_ns\n");
+    printf("%-28s %8s %12s %12s %12s\n", "case", "param", "min ns", "median ns", "p99 ns");
+
+    for(size_t fft_size = MIN_SUPPORTED_FFT_SIZE; fft_size <= MAX_SUPPORTED_FFT_SIZE; fft_size *= 2)
+    {
+        bench_run(csv, "compute_rfft", fft_size, setup_compute_rfft, run_compute_rfft);
+        bench_run(csv, "compute_rfft_split", fft_size, setup_compute_rfft_split, run_compute_rfft_split);
+    }
+
+    /* Sliding DFT replaces FFT_SIZE FFT for RGB modes, it is run once per capture block */
+    uint16_t tracked_bins[SLIDING_DFT_MAX_BINS];
+    size_t tracked_bins_count = visualize_get_tracked_bins(FFT_SIZE_HALF, tracked_bins, SLIDING_DFT_MAX_BINS);
+    sliding_dft_init(&sliding_dft, tracked_bins, tracked_bins_count);
+    bench_run(csv, "compute_rfft_split", FFT_SIZE, setup_compute_rfft_split, run_compute_rfft_split);
+    bench_run(csv, "sliding_dft_process", AUDIO_CAPTURE_BLOCK_SIZE, NULL, run_sliding_dft_process);
+
+    decimator_init(&decimator);
+    bench_run(csv, "decimator_process", AUDIO_CAPTURE_BLOCK_SIZE, NULL, run_decimator_process);
+
+    /* Detector is run on the full spectrum, every bin differs from the previous frame */
+    beat_detector_init(&beat_detector, FFT_SIZE, AUDIO_SAMPLING_RATE, (float)AUDIO_SAMPLING_RATE / AUDIO_HOP_SIZE);
+    setup_compute_rfft_split(FFT_SIZE);
+    run_compute_rfft_split(FFT_SIZE);
+    bench_run(csv, "beat_detector_process", beat_detector.bins_count, NULL, run_beat_detector_process);
+
+    /* fft_to_fgb() is static, it is measured as part of the modes that use it */
+    for(size_t mode = 0; mode < VISUALIZATION_MODE_MAX; mode++)
+    {
+        bench_run(csv, "visualize_fft", mode, setup_visualize_fft, run_visualize_fft);
+    }
+
+    bench_run(csv, "ws2812_set_leds", WS2812_LEDS_COUNT, NULL, run_ws2812_set_leds);
+    bench_run(csv, "ws2812_set_led", WS2812_LEDS_COUNT, NULL, run_ws2812_set_led);
+    ws2812_ring_init(&ring, ring_pixels, WS2812_LEDS_COUNT, ws2812_ring_newest_first);
+    bench_run(csv, "ws2812_ring", WS2812_LEDS_COUNT, NULL, run_ws2812_ring);
+    bench_run(csv, "ws2812_update", WS2812_LEDS_COUNT, NULL, run_ws2812_update);
+
+    fclose(csv);
+    printf("\nResults are written to %s\n", csv_path);
+
+    return EXIT_SUCCESS;
+}
+
+/* Runs the case and collects statistics. setup is not timed */
+static bench_stats_t bench_run(FILE* csv, const char* name, size_t param, bench_fn_t setup, bench_fn_t run)
+{
+    static uint32_t durations[BENCH_RUNS];
+    bench_stats_t stats;
+
+    for(size_t i = 0; i < (BENCH_WARMUP_RUNS + BENCH_RUNS); i++)
+    {
+        if(NULL != setup)
+        {
+            setup(param);
+        }
+
+        cyhal_timer_stop(&timer_obj);
+        cyhal_timer_reset(&timer_obj);
+        cyhal_timer_start(&timer_obj);
+
+        run(param);
+
+        uint32_t duration = cyhal_timer_read(&timer_obj);
+        if(i >= BENCH_WARMUP_RUNS)
+        {
+            durations[i - BENCH_WARMUP_RUNS] = duration;
+        }
+    }
+
+    qsort(durations, BENCH_RUNS, sizeof(durations[0]), compare_durations);
+    stats.min = durations[0];
+    stats.median = durations[BENCH_RUNS / 2];
+    stats.p99 = durations[((BENCH_RUNS * 99) + 99) / 100 - 1];
+
+    printf("%-28s %8zu %12u %12u %12u\n", name, param, stats.min, stats.median, stats.p99);
+    fprintf(csv, "%s,%zu,%u,%u,%u,%u\n", name, param, BENCH_RUNS, stats.min, stats.median, stats.p99);
+
+    return stats;
+}
+
+static int compare_durations(const void* a, const void* b)
+{
+    uint32_t lhs = *(const uint32_t*)a;
+    uint32_t rhs = *(const uint32_t*)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+/* Few tones and some noise in the range of the ADC */
+static void generate_signal(int16_t* res, size_t length)
+{
+    const int32_t amplitude = (1 << (AUDIO_SAMPLE_BITS - 1)) / 4;
+    uint32_t noise = 1;
+    for(size_t i = 0; i < length; i++)
+    {
+        noise = (noise * 1103515245u) + 12345u;
+        float t = (float)i / AUDIO_SAMPLING_RATE;
+        res[i] = amplitude * sinf(2 * PI * 60 * t) +
+                 amplitude * sinf(2 * PI * 1000 * t) +
+                 amplitude * sinf(2 * PI * 8000 * t) +
+                 (int32_t)((noise >> 16) % (amplitude / 4));
+    }
+}
+
+/* compute_rfft() takes 32 bit samples and converts them in place,
+ * so it gets a fresh copy every run */
+static void setup_compute_rfft(size_t fft_size)
+{
+    arm_rfft_fast_init_f32(&fft_f32_obj, fft_size);
+    for(size_t i = 0; i < fft_size; i++)
+    {
+        input_copy[i] = input_signal[i];
+    }
+}
+
+static void run_compute_rfft(size_t fft_size)
+{
+    compute_rfft(&fft_f32_obj, input_copy, fft_res, fft_size);
+}
+
+static void setup_compute_rfft_split(size_t fft_size)
+{
+    fft_plan = fft_get_plan(fft_size);
+}
+
+static void run_compute_rfft_split(size_t fft_size)
+{
+    compute_rfft_split(fft_plan, input_signal, fft_size, NULL, &fft_dc_tracker, fft_work, fft_res, fft_size, 0,
+                       fft_size / 2);
+}
+
+static void setup_visualize_fft(size_t mode)
+{
+    size_t first_bin;
+    size_t bins_count;
+
+    if(0 != (visualize_get_needs(mode) & VISUALIZE_NEEDS_TRACKED_BINS))
+    {
+        sliding_dft_get_power(&sliding_dft, fft_res);
+        spectrum_size = sliding_dft.bins_count;
+    }
+    else
+    {
+        visualize_get_bins(mode, FFT_SIZE_HALF, &first_bin, &bins_count);
+        if(0 != (visualize_get_needs(mode) & VISUALIZE_NEEDS_BEAT))
+        {
+            beat_detector_get_bins(&beat_detector, &first_bin, &bins_count);
+        }
+        compute_rfft_split(fft_get_plan(FFT_SIZE), input_signal, FFT_SIZE, NULL, &fft_dc_tracker, fft_work, fft_res,
+                           FFT_SIZE, first_bin, bins_count);
+        spectrum_size = FFT_SIZE_HALF;
+    }
+
+    /* Bass spectrum of the same signal, it is not decimated but it is fine for timing */
+    visualize_get_bass_bins(mode, &first_bin, &bins_count);
+    compute_rfft_split(fft_get_plan(BASS_FFT_SIZE), input_signal, BASS_FFT_SIZE, NULL, &fft_dc_tracker, fft_work,
+                       bass_res, BASS_FFT_SIZE, first_bin, bins_count);
+}
+
+/* Every frame is a new beat, so beat pulse mode always draws a fresh pulse */
+static void run_visualize_fft(size_t mode)
+{
+    beat.beat_count++;
+    visualize_fft(fft_res, spectrum_size, bass_res, &beat, mode);
+}
+
+static void run_decimator_process(size_t block_size)
+{
+    (void)block_size;
+    decimator_process(&decimator, input_signal);
+}
+
+static void run_sliding_dft_process(size_t block_size)
+{
+    sliding_dft_process(&sliding_dft, input_signal, block_size);
+}
+
+static void run_beat_detector_process(size_t bins_count)
+{
+    (void)bins_count;
+    beat_info_t info;
+
+    /* One bin rises on every call, so flux is never zero */
+    fft_res[beat_detector.first_bin + (beat.beat_count % beat_detector.bins_count)] *= 1.5f;
+    beat.beat_count++;
+    beat_detector_process(&beat_detector, fft_res, &info);
+}
+
+static void run_ws2812_set_leds(size_t count)
+{
+    ws2812_set_leds(colors, 0, count);
+}
+
+static void run_ws2812_set_led(size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        ws2812_set_led(i, colors[i].r, colors[i].g, colors[i].b);
+    }
+}
+
+/* One frame of the snake mode */
+static void run_ws2812_ring(size_t count)
+{
+    (void)count;
+    ws2812_ring_push(&ring, colors[0].r, colors[0].g, colors[0].b);
+    ws2812_set_ring(&ring, 0);
+}
+
+static void run_ws2812_update(size_t count)
+{
+    (void)count;
+    ws2812_update();
+}
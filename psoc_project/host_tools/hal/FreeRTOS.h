@@ -0,0 +1,28 @@
+#ifndef __FREERTOS_HOST_H__
+#define __FREERTOS_HOST_H__
+
+/* Stand-in for the parts of FreeRTOS that are used by the libraries.
+ * Host build is single threaded, so semaphores are plain counters */
+
+#include <stdint.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdPASS                  (pdTRUE)
+#define pdFAIL                  (pdFALSE)
+#define portMAX_DELAY           ((TickType_t)0xffffffffu)
+#define portYIELD_FROM_ISR(x)   ((void)(x))
+
+typedef struct
+{
+    UBaseType_t count;
+    UBaseType_t max_count;
+} StaticSemaphore_t;
+
+typedef StaticSemaphore_t* SemaphoreHandle_t;
+
+#endif /* __FREERTOS_HOST_H__ */
@@ -0,0 +1,185 @@
+#ifndef __CY_PDL_HOST_H__
+#define __CY_PDL_HOST_H__
+
+/* Stand-in for the parts of PDL that are used by the libraries,
+ * so they can be built and run on a Linux host */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Interrupts. Handlers registered with Cy_SysInt_Init() are called
+ * by the peripheral models once the interrupt is enabled */
+typedef enum
+{
+    cpuss_interrupts_dw0_0_IRQn = 0,
+    cpuss_interrupts_dw1_0_IRQn = 16,
+    CY_HOST_IRQ_COUNT = 32
+} IRQn_Type;
+
+typedef void (*cy_israddress)(void);
+
+typedef struct
+{
+    IRQn_Type intrSrc;
+    uint32_t intrPriority;
+} cy_stc_sysint_t;
+
+typedef enum
+{
+    CY_SYSINT_SUCCESS,
+    CY_SYSINT_BAD_PARAM
+} cy_en_sysint_status_t;
+
+cy_en_sysint_status_t Cy_SysInt_Init(const cy_stc_sysint_t* config, cy_israddress user_isr);
+void NVIC_EnableIRQ(IRQn_Type irqn);
+void NVIC_DisableIRQ(IRQn_Type irqn);
+
+/* SAR ADC registers, only channel results */
+typedef struct
+{
+    volatile uint32_t CHAN_RESULT[16];
+} SAR_Type;
+
+/* DataWire DMA. Every trigger moves one element of a 1D descriptor,
+ * after the last element the channel moves to the next descriptor.
+ * Descriptors are read from memory on every trigger, like on target,
+ * so next descriptor can be changed while the channel runs */
+typedef enum
+{
+    CY_DMA_SUCCESS,
+    CY_DMA_BAD_PARAM
+} cy_en_dma_status_t;
+
+typedef enum
+{
+    CY_DMA_RETRIG_IM,
+    CY_DMA_RETRIG_4CYC,
+    CY_DMA_RETRIG_16CYC,
+    CY_DMA_WAIT_FOR_REACT
+} cy_en_dma_retrigger_t;
+
+typedef enum
+{
+    CY_DMA_1ELEMENT,
+    CY_DMA_X_LOOP,
+    CY_DMA_DESCR,
+    CY_DMA_DESCR_CHAIN
+} cy_en_dma_trigger_type_t;
+
+typedef enum
+{
+    CY_DMA_CHANNEL_ENABLED,
+    CY_DMA_CHANNEL_DISABLED
+} cy_en_dma_channel_state_t;
+
+typedef enum
+{
+    CY_DMA_BYTE,
+    CY_DMA_HALFWORD,
+    CY_DMA_WORD
+} cy_en_dma_data_size_t;
+
+typedef enum
+{
+    CY_DMA_TRANSFER_SIZE_DATA,
+    CY_DMA_TRANSFER_SIZE_WORD
+} cy_en_dma_transfer_size_t;
+
+typedef enum
+{
+    CY_DMA_SINGLE_TRANSFER,
+    CY_DMA_1D_TRANSFER,
+    CY_DMA_2D_TRANSFER,
+    CY_DMA_CRC_TRANSFER
+} cy_en_dma_descriptor_type_t;
+
+#define CY_DMA_INTR_MASK            (0x01UL)
+#define CY_DMA_LOOP_COUNT_MAX       (256UL)
+
+struct cy_stc_dma_descriptor;
+
+typedef struct
+{
+    cy_en_dma_retrigger_t retrigger;
+    cy_en_dma_trigger_type_t interruptType;
+    cy_en_dma_trigger_type_t triggerOutType;
+    cy_en_dma_channel_state_t channelStateOnCompletion;
+    cy_en_dma_trigger_type_t triggerInType;
+    cy_en_dma_data_size_t dataSize;
+    cy_en_dma_transfer_size_t srcTransferSize;
+    cy_en_dma_transfer_size_t dstTransferSize;
+    cy_en_dma_descriptor_type_t descriptorType;
+    void* srcAddress;
+    void* dstAddress;
+    int32_t srcXincrement;
+    int32_t dstXincrement;
+    uint32_t xCount;
+    int32_t srcYincrement;
+    int32_t dstYincrement;
+    uint32_t yCount;
+    struct cy_stc_dma_descriptor* nextDescriptor;
+} cy_stc_dma_descriptor_config_t;
+
+typedef struct cy_stc_dma_descriptor
+{
+    cy_stc_dma_descriptor_config_t config;
+} cy_stc_dma_descriptor_t;
+
+typedef struct
+{
+    cy_stc_dma_descriptor_t* descriptor;
+    bool preemptable;
+    uint32_t priority;
+    bool enable;
+    bool bufferable;
+} cy_stc_dma_channel_config_t;
+
+#define CY_HOST_DW_CHANNELS         (16)
+
+typedef struct
+{
+    cy_stc_dma_descriptor_t* descriptor;
+    uint32_t index;
+    bool enabled;
+    uint32_t intr;
+    uint32_t intr_mask;
+    bool irq_pending;
+    size_t irq_delay;
+} cy_host_dw_channel_t;
+
+typedef struct
+{
+    bool enabled;
+    cy_host_dw_channel_t CH[CY_HOST_DW_CHANNELS];
+} DW_Type;
+
+extern DW_Type cy_host_dw[2];
+#define DW0                         (&cy_host_dw[0])
+#define DW1                         (&cy_host_dw[1])
+
+cy_en_dma_status_t Cy_DMA_Descriptor_Init(cy_stc_dma_descriptor_t* descriptor, const cy_stc_dma_descriptor_config_t* config);
+void Cy_DMA_Descriptor_SetNextDescriptor(cy_stc_dma_descriptor_t* descriptor, const cy_stc_dma_descriptor_t* nextDescriptor);
+cy_en_dma_status_t Cy_DMA_Channel_Init(DW_Type* base, uint32_t channel, const cy_stc_dma_channel_config_t* config);
+void Cy_DMA_Channel_SetDescriptor(DW_Type* base, uint32_t channel, const cy_stc_dma_descriptor_t* descriptor);
+cy_stc_dma_descriptor_t* Cy_DMA_Channel_GetCurrentDescriptor(DW_Type const* base, uint32_t channel);
+void Cy_DMA_Channel_Enable(DW_Type* base, uint32_t channel);
+void Cy_DMA_Channel_Disable(DW_Type* base, uint32_t channel);
+void Cy_DMA_Channel_SetInterruptMask(DW_Type* base, uint32_t channel, uint32_t interrupt);
+uint32_t Cy_DMA_Channel_GetInterruptStatus(DW_Type const* base, uint32_t channel);
+void Cy_DMA_Channel_ClearInterrupt(DW_Type* base, uint32_t channel);
+void Cy_DMA_Enable(DW_Type* base);
+void Cy_DMA_Disable(DW_Type* base);
+
+/* Trigger of the channel from a peripheral model, returns false when
+ * the element was not moved because DMA or the channel is disabled */
+bool cy_host_dma_trigger(DW_Type* base, uint32_t channel);
+
+/* Completion IRQ is served only after this many more triggers of the channel,
+ * so tests can check that DMA goes on while the IRQ waits. 0 serves it right away */
+void cy_host_dma_set_irq_latency(size_t triggers);
+
+/* Serves IRQs that are still waiting, as CPU would once triggers stop */
+void cy_host_dma_serve_irqs(void);
+
+#endif /* __CY_PDL_HOST_H__ */
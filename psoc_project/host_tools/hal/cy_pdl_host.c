@@ -0,0 +1,216 @@
+#include "cy_pdl.h"
+#include <string.h>
+
+DW_Type cy_host_dw[2];
+
+static cy_israddress irq_handlers[CY_HOST_IRQ_COUNT];
+static bool irq_enabled[CY_HOST_IRQ_COUNT];
+
+/* Triggers a waiting completion IRQ is delayed by */
+static size_t dma_irq_latency = 0;
+
+static IRQn_Type dma_irqn(DW_Type const* base, uint32_t channel);
+static void dma_serve_irq(DW_Type* base, uint32_t channel);
+static size_t dma_element_size(cy_en_dma_data_size_t data_size, cy_en_dma_transfer_size_t transfer_size);
+
+cy_en_sysint_status_t Cy_SysInt_Init(const cy_stc_sysint_t* config, cy_israddress user_isr)
+{
+    if((NULL == config) || (config->intrSrc >= CY_HOST_IRQ_COUNT))
+    {
+        return CY_SYSINT_BAD_PARAM;
+    }
+
+    irq_handlers[config->intrSrc] = user_isr;
+    return CY_SYSINT_SUCCESS;
+}
+
+void NVIC_EnableIRQ(IRQn_Type irqn)
+{
+    irq_enabled[irqn] = true;
+}
+
+void NVIC_DisableIRQ(IRQn_Type irqn)
+{
+    irq_enabled[irqn] = false;
+}
+
+cy_en_dma_status_t Cy_DMA_Descriptor_Init(cy_stc_dma_descriptor_t* descriptor, const cy_stc_dma_descriptor_config_t* config)
+{
+    if((NULL == descriptor) || (NULL == config) || (CY_DMA_1D_TRANSFER != config->descriptorType) ||
+       (0 == config->xCount) || (config->xCount > CY_DMA_LOOP_COUNT_MAX))
+    {
+        return CY_DMA_BAD_PARAM;
+    }
+
+    descriptor->config = *config;
+    return CY_DMA_SUCCESS;
+}
+
+void Cy_DMA_Descriptor_SetNextDescriptor(cy_stc_dma_descriptor_t* descriptor, const cy_stc_dma_descriptor_t* nextDescriptor)
+{
+    descriptor->config.nextDescriptor = (cy_stc_dma_descriptor_t*)nextDescriptor;
+}
+
+cy_en_dma_status_t Cy_DMA_Channel_Init(DW_Type* base, uint32_t channel, const cy_stc_dma_channel_config_t* config)
+{
+    if((channel >= CY_HOST_DW_CHANNELS) || (NULL == config) || (NULL == config->descriptor))
+    {
+        return CY_DMA_BAD_PARAM;
+    }
+
+    memset(&base->CH[channel], 0, sizeof(base->CH[channel]));
+    base->CH[channel].descriptor = config->descriptor;
+    base->CH[channel].enabled = config->enable;
+    return CY_DMA_SUCCESS;
+}
+
+void Cy_DMA_Channel_SetDescriptor(DW_Type* base, uint32_t channel, const cy_stc_dma_descriptor_t* descriptor)
+{
+    base->CH[channel].descriptor = (cy_stc_dma_descriptor_t*)descriptor;
+    base->CH[channel].index = 0;
+}
+
+cy_stc_dma_descriptor_t* Cy_DMA_Channel_GetCurrentDescriptor(DW_Type const* base, uint32_t channel)
+{
+    return base->CH[channel].descriptor;
+}
+
+void Cy_DMA_Channel_Enable(DW_Type* base, uint32_t channel)
+{
+    base->CH[channel].enabled = true;
+}
+
+void Cy_DMA_Channel_Disable(DW_Type* base, uint32_t channel)
+{
+    base->CH[channel].enabled = false;
+}
+
+void Cy_DMA_Channel_SetInterruptMask(DW_Type* base, uint32_t channel, uint32_t interrupt)
+{
+    base->CH[channel].intr_mask = interrupt;
+}
+
+uint32_t Cy_DMA_Channel_GetInterruptStatus(DW_Type const* base, uint32_t channel)
+{
+    return base->CH[channel].intr & base->CH[channel].intr_mask;
+}
+
+void Cy_DMA_Channel_ClearInterrupt(DW_Type* base, uint32_t channel)
+{
+    base->CH[channel].intr = 0;
+}
+
+void Cy_DMA_Enable(DW_Type* base)
+{
+    base->enabled = true;
+}
+
+void Cy_DMA_Disable(DW_Type* base)
+{
+    base->enabled = false;
+}
+
+bool cy_host_dma_trigger(DW_Type* base, uint32_t channel)
+{
+    cy_host_dw_channel_t* ch = &base->CH[channel];
+
+    if(!base->enabled || !ch->enabled || (NULL == ch->descriptor))
+    {
+        return false;
+    }
+
+    const cy_stc_dma_descriptor_config_t* cfg = &ch->descriptor->config;
+    size_t src_size = dma_element_size(cfg->dataSize, cfg->srcTransferSize);
+    size_t dst_size = dma_element_size(cfg->dataSize, cfg->dstTransferSize);
+    size_t data_size = dma_element_size(cfg->dataSize, CY_DMA_TRANSFER_SIZE_DATA);
+    const uint8_t* src = (const uint8_t*)cfg->srcAddress + ((int32_t)ch->index * cfg->srcXincrement * (int32_t)data_size);
+    uint8_t* dst = (uint8_t*)cfg->dstAddress + ((int32_t)ch->index * cfg->dstXincrement * (int32_t)data_size);
+    uint32_t value = 0;
+
+    /* Little endian, so the narrower side keeps the lower bytes */
+    memcpy(&value, src, src_size);
+    memcpy(dst, &value, dst_size);
+
+    bool raised = false;
+    ch->index++;
+    if(ch->index == cfg->xCount)
+    {
+        if(CY_DMA_DESCR == cfg->interruptType)
+        {
+            ch->intr |= CY_DMA_INTR_MASK;
+            if(!ch->irq_pending && (0u != (ch->intr & ch->intr_mask)) && irq_enabled[dma_irqn(base, channel)])
+            {
+                ch->irq_pending = true;
+                ch->irq_delay = dma_irq_latency;
+                raised = true;
+            }
+        }
+
+        ch->index = 0;
+        if((CY_DMA_CHANNEL_ENABLED == cfg->channelStateOnCompletion) && (NULL != cfg->nextDescriptor))
+        {
+            ch->descriptor = cfg->nextDescriptor;
+        }
+        else
+        {
+            ch->enabled = false;
+        }
+    }
+
+    /* IRQ raised before waits for its latency to pass */
+    if(ch->irq_pending && !raised)
+    {
+        ch->irq_delay--;
+    }
+    if(ch->irq_pending && (0 == ch->irq_delay))
+    {
+        dma_serve_irq(base, channel);
+    }
+
+    return true;
+}
+
+void cy_host_dma_set_irq_latency(size_t triggers)
+{
+    dma_irq_latency = triggers;
+}
+
+void cy_host_dma_serve_irqs(void)
+{
+    for(size_t dw = 0; dw < 2; dw++)
+    {
+        for(uint32_t channel = 0; channel < CY_HOST_DW_CHANNELS; channel++)
+        {
+            if(cy_host_dw[dw].CH[channel].irq_pending)
+            {
+                dma_serve_irq(&cy_host_dw[dw], channel);
+            }
+        }
+    }
+}
+
+static IRQn_Type dma_irqn(DW_Type const* base, uint32_t channel)
+{
+    return (IRQn_Type)(((DW0 == base) ? cpuss_interrupts_dw0_0_IRQn : cpuss_interrupts_dw1_0_IRQn) + channel);
+}
+
+static void dma_serve_irq(DW_Type* base, uint32_t channel)
+{
+    IRQn_Type irqn = dma_irqn(base, channel);
+
+    base->CH[channel].irq_pending = false;
+    if(NULL != irq_handlers[irqn])
+    {
+        irq_handlers[irqn]();
+    }
+}
+
+static size_t dma_element_size(cy_en_dma_data_size_t data_size, cy_en_dma_transfer_size_t transfer_size)
+{
+    if(CY_DMA_TRANSFER_SIZE_WORD == transfer_size)
+    {
+        return 4;
+    }
+
+    return (CY_DMA_BYTE == data_size) ? 1 : ((CY_DMA_HALFWORD == data_size) ? 2 : 4);
+}
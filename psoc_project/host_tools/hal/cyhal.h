@@ -0,0 +1,236 @@
+#ifndef __CYHAL_HOST_H__
+#define __CYHAL_HOST_H__
+
+/* Stand-in for the parts of cyhal that are used by the libraries,
+ * so they can be built and run on a Linux host */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "cy_pdl.h"
+
+typedef uint32_t cy_rslt_t;
+#define CY_RSLT_SUCCESS             ((cy_rslt_t)0u)
+#define CY_RSLT_HOST_ERROR          ((cy_rslt_t)1u)
+
+typedef int32_t cyhal_gpio_t;
+#define NC                          ((cyhal_gpio_t)-1)
+
+#define CYHAL_ISR_PRIORITY_DEFAULT  (7)
+#define CYHAL_DMA_PRIORITY_DEFAULT  (3)
+
+/* Core intrinsics that are provided by CMSIS core on the target */
+static inline uint32_t __REV(uint32_t value)
+{
+    return __builtin_bswap32(value);
+}
+
+#ifndef __UNALIGNED_UINT32_WRITE
+#define __UNALIGNED_UINT32_WRITE(addr, val) \
+    do { uint32_t __val = (val); memcpy((void*)(addr), &__val, sizeof(__val)); } while(0)
+#endif
+
+/* Host tools are single threaded, so exclusive store always succeeds */
+static inline uint32_t __LDREXW(volatile uint32_t* addr)
+{
+    return *addr;
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t* addr)
+{
+    *addr = value;
+    return 0;
+}
+
+static inline void __DMB(void)
+{
+    __sync_synchronize();
+}
+
+static inline uint32_t cyhal_system_critical_section_enter(void)
+{
+    return 0;
+}
+
+static inline void cyhal_system_critical_section_exit(uint32_t old_state)
+{
+    (void)old_state;
+}
+
+/* Timer */
+typedef enum
+{
+    CYHAL_TIMER_DIR_UP
+} cyhal_timer_direction_t;
+
+typedef struct
+{
+    bool is_continuous;
+    cyhal_timer_direction_t direction;
+    bool is_compare;
+    uint32_t period;
+    uint32_t compare_value;
+    uint32_t value;
+} cyhal_timer_cfg_t;
+
+typedef struct
+{
+    uint32_t frequency;
+    bool running;
+    uint64_t start_ns;
+    uint64_t elapsed_ns;
+} cyhal_timer_t;
+
+cy_rslt_t cyhal_timer_init(cyhal_timer_t* obj, cyhal_gpio_t pin, const void* clk);
+cy_rslt_t cyhal_timer_configure(cyhal_timer_t* obj, const cyhal_timer_cfg_t* cfg);
+cy_rslt_t cyhal_timer_set_frequency(cyhal_timer_t* obj, uint32_t hz);
+cy_rslt_t cyhal_timer_start(cyhal_timer_t* obj);
+cy_rslt_t cyhal_timer_stop(cyhal_timer_t* obj);
+cy_rslt_t cyhal_timer_reset(cyhal_timer_t* obj);
+uint32_t cyhal_timer_read(const cyhal_timer_t* obj);
+
+/* Timers count host monotonic time until this is called. From then on
+ * they count the given time instead, so offline tools can run on audio time */
+void cyhal_host_set_time(uint64_t time_ns);
+
+/* SPI. Transfers complete right away, transfer started from a callback
+ * completes after that callback returns, like a pending IRQ would.
+ * While cyhal_host_spi_hold() is set transfers stay busy until
+ * cyhal_host_spi_complete() is called. Sent data can be inspected
+ * through the callback registered with cyhal_host_spi_set_sink(),
+ * it is called when transfer completes, MOSI pin tells which SPI block sent it */
+typedef enum
+{
+    CYHAL_SPI_MODE_11_MSB
+} cyhal_spi_mode_t;
+
+typedef enum
+{
+    CYHAL_SPI_IRQ_NONE = 0,
+    CYHAL_SPI_IRQ_DONE = 1 << 1,
+    CYHAL_SPI_IRQ_ERROR = 1 << 3
+} cyhal_spi_event_t;
+
+typedef enum
+{
+    CYHAL_ASYNC_SW,
+    CYHAL_ASYNC_DMA
+} cyhal_async_mode_t;
+
+typedef void (*cyhal_spi_event_callback_t)(void* callback_arg, cyhal_spi_event_t event);
+typedef void (*cyhal_host_spi_sink_t)(cyhal_gpio_t mosi, const uint8_t* data, size_t length);
+
+typedef struct cyhal_spi
+{
+    cyhal_gpio_t mosi;
+    cyhal_spi_event_callback_t callback;
+    void* callback_arg;
+    cyhal_spi_event_t events;
+    bool busy;
+    const uint8_t* tx;
+    size_t tx_length;
+    struct cyhal_spi* next_pending;
+} cyhal_spi_t;
+
+cy_rslt_t cyhal_spi_init(cyhal_spi_t* obj, cyhal_gpio_t mosi, cyhal_gpio_t miso, cyhal_gpio_t sclk, cyhal_gpio_t ssel,
+                         const void* clk, uint8_t bits, cyhal_spi_mode_t mode, bool is_slave);
+void cyhal_spi_free(cyhal_spi_t* obj);
+cy_rslt_t cyhal_spi_set_frequency(cyhal_spi_t* obj, uint32_t hz);
+cy_rslt_t cyhal_spi_set_async_mode(cyhal_spi_t* obj, cyhal_async_mode_t mode, uint8_t dma_priority);
+void cyhal_spi_register_callback(cyhal_spi_t* obj, cyhal_spi_event_callback_t callback, void* callback_arg);
+void cyhal_spi_enable_event(cyhal_spi_t* obj, cyhal_spi_event_t event, uint8_t intr_priority, bool enable);
+cy_rslt_t cyhal_spi_transfer(cyhal_spi_t* obj, const uint8_t* tx, size_t tx_length, uint8_t* rx, size_t rx_length,
+                             uint8_t write_fill);
+cy_rslt_t cyhal_spi_transfer_async(cyhal_spi_t* obj, const uint8_t* tx, size_t tx_length, uint8_t* rx, size_t rx_length);
+bool cyhal_spi_is_busy(cyhal_spi_t* obj);
+void cyhal_host_spi_set_sink(cyhal_host_spi_sink_t sink);
+void cyhal_host_spi_hold(bool hold);
+size_t cyhal_host_spi_complete(void);
+
+/* ADC and DMA. Only continuous scanning with scan complete output triggering
+ * a DataWire channel is modelled. cyhal_host_adc_feed() writes every sample to the
+ * result register of every channel and triggers the DMA channel routed to the ADC
+ * with cyhal_dma_init_adv(), then serves DMA IRQs that are still waiting.
+ * Samples fed while the DMA channel is disabled are lost, like on target,
+ * and counted in lost_samples */
+typedef struct
+{
+    uint8_t type;
+    uint8_t block_num;
+    uint8_t channel_num;
+} cyhal_resource_inst_t;
+
+typedef enum
+{
+    CYHAL_ADC_OUTPUT_SCAN_COMPLETE
+} cyhal_adc_output_t;
+
+typedef struct
+{
+    bool enable_averaging;
+    uint32_t min_acquisition_ns;
+    bool enabled;
+} cyhal_adc_channel_config_t;
+
+struct cyhal_dma;
+
+typedef struct
+{
+    SAR_Type sar;
+    SAR_Type* base;
+    uint8_t channels_count;
+    bool scan_output;
+    struct cyhal_dma* dma;
+    uint32_t lost_samples;
+} cyhal_adc_t;
+
+typedef struct
+{
+    cyhal_adc_t* adc;
+    uint8_t channel_idx;
+} cyhal_adc_channel_t;
+
+/* ADC scan complete is the only trigger source of host build */
+typedef cyhal_adc_t* cyhal_source_t;
+
+typedef enum
+{
+    CYHAL_DMA_INPUT_TRIGGER_SINGLE_ELEMENT,
+    CYHAL_DMA_INPUT_TRIGGER_SINGLE_BURST,
+    CYHAL_DMA_INPUT_TRIGGER_ALL_ELEMENTS
+} cyhal_dma_input_t;
+
+typedef enum
+{
+    CYHAL_DMA_DIRECTION_MEM2MEM,
+    CYHAL_DMA_DIRECTION_MEM2PERIPH,
+    CYHAL_DMA_DIRECTION_PERIPH2MEM,
+    CYHAL_DMA_DIRECTION_PERIPH2PERIPH
+} cyhal_dma_direction_t;
+
+typedef struct
+{
+    cyhal_source_t source;
+    cyhal_dma_input_t input;
+} cyhal_dma_src_t;
+
+typedef struct
+{
+    cyhal_source_t dest;
+} cyhal_dma_dest_t;
+
+typedef struct cyhal_dma
+{
+    cyhal_resource_inst_t resource;
+} cyhal_dma_t;
+
+cy_rslt_t cyhal_adc_init(cyhal_adc_t* obj, cyhal_gpio_t pin, const void* clk);
+cy_rslt_t cyhal_adc_channel_init_diff(cyhal_adc_channel_t* obj, cyhal_adc_t* adc, cyhal_gpio_t vplus, cyhal_gpio_t vminus,
+                                      const cyhal_adc_channel_config_t* cfg);
+cy_rslt_t cyhal_adc_enable_output(cyhal_adc_t* obj, cyhal_adc_output_t output, cyhal_source_t* source);
+cy_rslt_t cyhal_dma_init_adv(cyhal_dma_t* obj, cyhal_dma_src_t* src, cyhal_dma_dest_t* dest, cyhal_source_t* dest_source,
+                             uint8_t priority, cyhal_dma_direction_t direction);
+void cyhal_host_adc_feed(cyhal_adc_t* obj, const int32_t* samples, size_t count);
+
+#endif /* __CYHAL_HOST_H__ */
@@ -0,0 +1,347 @@
+#include "cyhal.h"
+#include <time.h>
+
+static cyhal_host_spi_sink_t spi_sink = NULL;
+
+/* Transfers whose complete event was not raised yet */
+static cyhal_spi_t* spi_pending_head = NULL;
+static cyhal_spi_t* spi_pending_tail = NULL;
+static bool spi_in_callback = false;
+
+/* Set by cyhal_host_spi_hold(), pending transfers wait for cyhal_host_spi_complete() */
+static bool spi_hold = false;
+
+/* Time set by cyhal_host_set_time(), used instead of the host clock once set */
+static bool manual_time = false;
+static uint64_t manual_time_ns = 0;
+
+static uint64_t host_time_ns(void)
+{
+    if(manual_time)
+    {
+        return manual_time_ns;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000u) + now.tv_nsec;
+}
+
+cy_rslt_t cyhal_timer_init(cyhal_timer_t* obj, cyhal_gpio_t pin, const void* clk)
+{
+    (void)pin;
+    (void)clk;
+
+    /* Default frequency of cyhal timer is 1 MHz */
+    obj->frequency = 1000000;
+    obj->running = false;
+    obj->start_ns = 0;
+    obj->elapsed_ns = 0;
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_timer_configure(cyhal_timer_t* obj, const cyhal_timer_cfg_t* cfg)
+{
+    (void)obj;
+    (void)cfg;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_timer_set_frequency(cyhal_timer_t* obj, uint32_t hz)
+{
+    obj->frequency = hz;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_timer_start(cyhal_timer_t* obj)
+{
+    if(!obj->running)
+    {
+        obj->start_ns = host_time_ns();
+        obj->running = true;
+    }
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_timer_stop(cyhal_timer_t* obj)
+{
+    if(obj->running)
+    {
+        obj->elapsed_ns += host_time_ns() - obj->start_ns;
+        obj->running = false;
+    }
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_timer_reset(cyhal_timer_t* obj)
+{
+    obj->elapsed_ns = 0;
+    obj->start_ns = host_time_ns();
+
+    return CY_RSLT_SUCCESS;
+}
+
+uint32_t cyhal_timer_read(const cyhal_timer_t* obj)
+{
+    uint64_t elapsed_ns = obj->elapsed_ns;
+    if(obj->running)
+    {
+        elapsed_ns += host_time_ns() - obj->start_ns;
+    }
+
+    return (uint32_t)((elapsed_ns * obj->frequency) / 1000000000u);
+}
+
+void cyhal_host_set_time(uint64_t time_ns)
+{
+    manual_time = true;
+    manual_time_ns = time_ns;
+}
+
+cy_rslt_t cyhal_spi_init(cyhal_spi_t* obj, cyhal_gpio_t mosi, cyhal_gpio_t miso, cyhal_gpio_t sclk, cyhal_gpio_t ssel,
+                         const void* clk, uint8_t bits, cyhal_spi_mode_t mode, bool is_slave)
+{
+    (void)miso;
+    (void)sclk;
+    (void)ssel;
+    (void)clk;
+    (void)bits;
+    (void)mode;
+    (void)is_slave;
+
+    memset(obj, 0, sizeof(*obj));
+    obj->mosi = mosi;
+
+    return CY_RSLT_SUCCESS;
+}
+
+void cyhal_spi_free(cyhal_spi_t* obj)
+{
+    (void)obj;
+}
+
+cy_rslt_t cyhal_spi_set_frequency(cyhal_spi_t* obj, uint32_t hz)
+{
+    (void)obj;
+    (void)hz;
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_spi_set_async_mode(cyhal_spi_t* obj, cyhal_async_mode_t mode, uint8_t dma_priority)
+{
+    (void)obj;
+    (void)mode;
+    (void)dma_priority;
+    return CY_RSLT_SUCCESS;
+}
+
+void cyhal_spi_register_callback(cyhal_spi_t* obj, cyhal_spi_event_callback_t callback, void* callback_arg)
+{
+    obj->callback = callback;
+    obj->callback_arg = callback_arg;
+}
+
+void cyhal_spi_enable_event(cyhal_spi_t* obj, cyhal_spi_event_t event, uint8_t intr_priority, bool enable)
+{
+    (void)intr_priority;
+    if(enable)
+    {
+        obj->events |= event;
+    }
+    else
+    {
+        obj->events &= ~event;
+    }
+}
+
+cy_rslt_t cyhal_spi_transfer(cyhal_spi_t* obj, const uint8_t* tx, size_t tx_length, uint8_t* rx, size_t rx_length,
+                             uint8_t write_fill)
+{
+    (void)write_fill;
+
+    if(NULL != spi_sink)
+    {
+        spi_sink(obj->mosi, tx, tx_length);
+    }
+    if(NULL != rx)
+    {
+        memset(rx, 0, rx_length);
+    }
+
+    return CY_RSLT_SUCCESS;
+}
+
+/* Data is "sent" right away and transfer complete event is raised
+ * from the caller context, as if IRQ fired immediately. Events of
+ * transfers started from a callback are queued until it returns.
+ * Sink gets the data on completion, so it sees changes made to it during transfer */
+cy_rslt_t cyhal_spi_transfer_async(cyhal_spi_t* obj, const uint8_t* tx, size_t tx_length, uint8_t* rx, size_t rx_length)
+{
+    if(NULL != rx)
+    {
+        memset(rx, 0, rx_length);
+    }
+
+    obj->busy = true;
+    obj->tx = tx;
+    obj->tx_length = tx_length;
+    obj->next_pending = NULL;
+    if(NULL == spi_pending_tail)
+    {
+        spi_pending_head = obj;
+    }
+    else
+    {
+        spi_pending_tail->next_pending = obj;
+    }
+    spi_pending_tail = obj;
+
+    if(!spi_in_callback && !spi_hold)
+    {
+        cyhal_host_spi_complete();
+    }
+
+    return CY_RSLT_SUCCESS;
+}
+
+bool cyhal_spi_is_busy(cyhal_spi_t* obj)
+{
+    return obj->busy;
+}
+
+void cyhal_host_spi_set_sink(cyhal_host_spi_sink_t sink)
+{
+    spi_sink = sink;
+}
+
+void cyhal_host_spi_hold(bool hold)
+{
+    spi_hold = hold;
+}
+
+/* Completes pending transfers in order they were started, including the ones
+ * started from their callbacks. Returns number of completed transfers */
+size_t cyhal_host_spi_complete(void)
+{
+    size_t completed = 0;
+
+    while(NULL != spi_pending_head)
+    {
+        cyhal_spi_t* done = spi_pending_head;
+        spi_pending_head = done->next_pending;
+        if(NULL == spi_pending_head)
+        {
+            spi_pending_tail = NULL;
+        }
+
+        if(NULL != spi_sink)
+        {
+            spi_sink(done->mosi, done->tx, done->tx_length);
+        }
+
+        done->busy = false;
+        completed++;
+        if((NULL != done->callback) && (0u != (done->events & CYHAL_SPI_IRQ_DONE)))
+        {
+            spi_in_callback = true;
+            done->callback(done->callback_arg, CYHAL_SPI_IRQ_DONE);
+            spi_in_callback = false;
+        }
+    }
+
+    return completed;
+}
+
+cy_rslt_t cyhal_adc_init(cyhal_adc_t* obj, cyhal_gpio_t pin, const void* clk)
+{
+    (void)pin;
+    (void)clk;
+
+    memset(obj, 0, sizeof(*obj));
+    obj->base = &obj->sar;
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_adc_channel_init_diff(cyhal_adc_channel_t* obj, cyhal_adc_t* adc, cyhal_gpio_t vplus, cyhal_gpio_t vminus,
+                                      const cyhal_adc_channel_config_t* cfg)
+{
+    (void)vplus;
+    (void)vminus;
+    (void)cfg;
+
+    if(adc->channels_count >= (sizeof(adc->sar.CHAN_RESULT) / sizeof(adc->sar.CHAN_RESULT[0])))
+    {
+        return CY_RSLT_HOST_ERROR;
+    }
+
+    obj->adc = adc;
+    obj->channel_idx = adc->channels_count++;
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t cyhal_adc_enable_output(cyhal_adc_t* obj, cyhal_adc_output_t output, cyhal_source_t* source)
+{
+    (void)output;
+
+    obj->scan_output = true;
+    *source = obj;
+
+    return CY_RSLT_SUCCESS;
+}
+
+/* Channels of DW0 are given out in order and never freed */
+cy_rslt_t cyhal_dma_init_adv(cyhal_dma_t* obj, cyhal_dma_src_t* src, cyhal_dma_dest_t* dest, cyhal_source_t* dest_source,
+                             uint8_t priority, cyhal_dma_direction_t direction)
+{
+    static uint8_t next_channel = 0;
+    (void)dest;
+    (void)dest_source;
+    (void)priority;
+    (void)direction;
+
+    if(next_channel >= CY_HOST_DW_CHANNELS)
+    {
+        return CY_RSLT_HOST_ERROR;
+    }
+
+    obj->resource.type = 0;
+    obj->resource.block_num = 0;
+    obj->resource.channel_num = next_channel++;
+
+    if((NULL != src) && (NULL != src->source))
+    {
+        if(CYHAL_DMA_INPUT_TRIGGER_SINGLE_ELEMENT != src->input)
+        {
+            return CY_RSLT_HOST_ERROR;
+        }
+        src->source->dma = obj;
+    }
+
+    return CY_RSLT_SUCCESS;
+}
+
+/* Result register keeps the sample in its lower half and the valid flag on top */
+void cyhal_host_adc_feed(cyhal_adc_t* obj, const int32_t* samples, size_t count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        for(size_t channel = 0; channel < obj->channels_count; channel++)
+        {
+            obj->sar.CHAN_RESULT[channel] = 0x80000000u | (uint16_t)samples[i];
+        }
+
+        bool moved = obj->scan_output && (NULL != obj->dma) &&
+                     cy_host_dma_trigger((0 == obj->dma->resource.block_num) ? DW0 : DW1, obj->dma->resource.channel_num);
+        if(!moved)
+        {
+            obj->lost_samples++;
+        }
+    }
+
+    cy_host_dma_serve_irqs();
+}
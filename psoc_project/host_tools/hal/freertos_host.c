@@ -0,0 +1,67 @@
+#include "semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static freertos_host_block_hook_t block_hook = NULL;
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer)
+{
+    return xSemaphoreCreateCountingStatic(1, 0, buffer);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max_count, UBaseType_t initial_count,
+                                                 StaticSemaphore_t* buffer)
+{
+    buffer->count = initial_count;
+    buffer->max_count = max_count;
+    return buffer;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait)
+{
+    if((0 == semaphore->count) && (NULL != block_hook) && (0 != ticks_to_wait))
+    {
+        block_hook(semaphore);
+    }
+
+    if(0 == semaphore->count)
+    {
+        /* Nobody else can give it on a single threaded host */
+        if(portMAX_DELAY == ticks_to_wait)
+        {
+            fprintf(stderr, "xSemaphoreTake would block forever\n");
+            abort();
+        }
+
+        return pdFALSE;
+    }
+
+    semaphore->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    if(semaphore->count >= semaphore->max_count)
+    {
+        return pdFALSE;
+    }
+
+    semaphore->count++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higher_priority_task_woken)
+{
+    if(NULL != higher_priority_task_woken)
+    {
+        *higher_priority_task_woken = pdFALSE;
+    }
+
+    return xSemaphoreGive(semaphore);
+}
+
+void freertos_host_set_block_hook(freertos_host_block_hook_t hook)
+{
+    block_hook = hook;
+}
@@ -0,0 +1,18 @@
+#ifndef __SEMPHR_HOST_H__
+#define __SEMPHR_HOST_H__
+
+#include "FreeRTOS.h"
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer);
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max_count, UBaseType_t initial_count,
+                                                 StaticSemaphore_t* buffer);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higher_priority_task_woken);
+
+/* Host build has no other task to give a semaphore, so a take that would block
+ * calls the hook instead, it can complete pending transfers like IRQs would */
+typedef void (*freertos_host_block_hook_t)(SemaphoreHandle_t semaphore);
+void freertos_host_set_block_hook(freertos_host_block_hook_t hook);
+
+#endif /* __SEMPHR_HOST_H__ */
@@ -0,0 +1,74 @@
+# Host build settings shared by the host tools, included from
+# their Makefiles so paths are relative to host_tools/<tool>
+
+APP_PATH=../../music_synch_led_project
+HAL_PATH=../hal
+CMSIS_PATH=../../CMSIS_5/CMSIS
+CMSISDSP_PATH=$(CMSIS_PATH)/DSP
+
+CC?=gcc
+CFLAGS+=-O2 -std=gnu11 -Wall -D__GNUC_PYTHON__
+LDLIBS+=-lm
+
+INCLUDES=-I$(HAL_PATH) \
+         -I$(APP_PATH) \
+         -I$(APP_PATH)/lib/audio_capture \
+         -I$(APP_PATH)/lib/fft_wrapper \
+         -I$(APP_PATH)/lib/audio_visualizer \
+         -I$(APP_PATH)/lib/spectrum_bands \
+         -I$(APP_PATH)/lib/ws2812 \
+         -I$(APP_PATH)/lib/led_matrix \
+         -I$(APP_PATH)/lib/trace \
+         -I$(APP_PATH)/lib/decimator \
+         -I$(APP_PATH)/lib/sliding_dft \
+         -I$(APP_PATH)/lib/beat_detector \
+         -I$(APP_PATH)/lib/latency \
+         -I$(CMSISDSP_PATH)/Include \
+         -I$(CMSIS_PATH)/Core/Include
+
+APP_SOURCES=$(APP_PATH)/lib/audio_capture/audio_capture.c \
+            $(APP_PATH)/lib/fft_wrapper/fft_wrapper.c \
+            $(APP_PATH)/lib/audio_visualizer/audio_visualizer.c \
+            $(APP_PATH)/lib/spectrum_bands/spectrum_bands.c \
+            $(APP_PATH)/lib/ws2812/ws2812.c \
+            $(APP_PATH)/lib/led_matrix/led_matrix.c \
+            $(APP_PATH)/lib/trace/trace.c \
+            $(APP_PATH)/lib/decimator/decimator.c \
+            $(APP_PATH)/lib/sliding_dft/sliding_dft.c \
+            $(APP_PATH)/lib/beat_detector/beat_detector.c \
+            $(APP_PATH)/lib/latency/latency.c
+
+HAL_SOURCES=$(HAL_PATH)/cyhal_host.c \
+            $(HAL_PATH)/cy_pdl_host.c \
+            $(HAL_PATH)/freertos_host.c
+
+# Same CMSIS DSP sources as in the application Makefile
+CMSISDSP_SOURCES=$(CMSISDSP_PATH)/Source/TransformFunctions/arm_rfft_fast_init_f32.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_rfft_fast_f32.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_cfft_init_f32.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_cfft_f32.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_cfft_radix8_f32.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_bitreversal2.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_rfft_init_q15.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_rfft_q15.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_cfft_q15.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_cfft_radix4_q15.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_rfft_init_q31.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_rfft_q31.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_cfft_q31.c \
+        $(CMSISDSP_PATH)/Source/TransformFunctions/arm_cfft_radix4_q31.c \
+        $(CMSISDSP_PATH)/Source/ComplexMathFunctions/arm_cmplx_mag_f32.c \
+        $(CMSISDSP_PATH)/Source/ComplexMathFunctions/arm_cmplx_mag_squared_f32.c \
+        $(CMSISDSP_PATH)/Source/ComplexMathFunctions/arm_cmplx_mag_squared_q15.c \
+        $(CMSISDSP_PATH)/Source/ComplexMathFunctions/arm_cmplx_mag_squared_q31.c \
+        $(CMSISDSP_PATH)/Source/SupportFunctions/arm_q31_to_float.c \
+        $(CMSISDSP_PATH)/Source/SupportFunctions/arm_q15_to_float.c \
+        $(CMSISDSP_PATH)/Source/SupportFunctions/arm_float_to_q15.c \
+        $(CMSISDSP_PATH)/Source/SupportFunctions/arm_fill_f32.c \
+        $(CMSISDSP_PATH)/Source/FilteringFunctions/arm_fir_decimate_init_f32.c \
+        $(CMSISDSP_PATH)/Source/FilteringFunctions/arm_fir_decimate_f32.c \
+        $(CMSISDSP_PATH)/Source/CommonTables/arm_common_tables.c \
+        $(CMSISDSP_PATH)/Source/CommonTables/arm_const_structs.c \
+        $(CMSISDSP_PATH)/Source/StatisticsFunctions/arm_mean_f32.c
+
+HOST_SOURCES=$(APP_SOURCES) $(HAL_SOURCES) $(CMSISDSP_SOURCES)
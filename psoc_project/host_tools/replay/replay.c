@@ -0,0 +1,756 @@
+/* Offline replay of a WAV file through the application pipeline.
+ * Audio is cut to capture blocks and analysed the same way as by the
+ * analysis task, frames are rendered at FRAME_RATE_FPS of audio time by
+ * the unmodified visualizer and ws2812 code. SPI data of every frame is
+ * decoded back to LED colours and written to a file as fast as possible.
+ * Host timers run on audio time, so latency is measured the same as on target
+ * except that analysis and LED transfer take no time */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "app_config.h"
+#include "cyhal.h"
+#include "fft_wrapper.h"
+#include "audio_visualizer.h"
+#include "ws2812.h"
+#include "sliding_dft.h"
+#include "beat_detector.h"
+#include "trace.h"
+#if MEASURE_LATENCY == 1
+#include "latency.h"
+#endif
+#if BASS_ANALYSIS == 1
+#include "decimator.h"
+#endif
+
+/* Binary output: header followed by WS2812_LEDS_COUNT RGB triplets per frame */
+#define REPLAY_MAGIC            ("LEDF")
+#define REPLAY_FORMAT_VERSION   (1)
+
+/* WAV chunk identifiers and PCM format tag */
+#define WAV_RIFF_ID             ("RIFF")
+#define WAV_WAVE_ID             ("WAVE")
+#define WAV_FMT_ID              ("fmt ")
+#define WAV_DATA_ID             ("data")
+#define WAV_FORMAT_PCM          (1)
+
+/* Converts number of samples to audio time in ns */
+#define REPLAY_SAMPLES_TO_NS(samples)   (((uint64_t)(samples) * 1000000000u) / AUDIO_SAMPLING_RATE)
+
+#if MEASURE_LATENCY == 1
+/* Impulse input: REPLAY_IMPULSE_COUNT clicks, one every REPLAY_IMPULSE_PERIOD samples.
+ * Click is full scale white noise decaying with REPLAY_IMPULSE_DECAY seconds time
+ * constant, so it reaches bins of every mode. It starts at the beginning of a capture block */
+#define REPLAY_IMPULSE_COUNT        (10)
+#define REPLAY_IMPULSE_PERIOD       (AUDIO_SAMPLING_RATE)
+#define REPLAY_IMPULSE_DECAY        (0.03f)
+#define REPLAY_IMPULSE_AMPLITUDE    ((1 << (AUDIO_SAMPLE_BITS - 1)) - 1)
+
+/* LEDs respond to a click when the sum of all their levels rises
+ * by this much over the last frame before the click */
+#define REPLAY_IMPULSE_MIN_RISE     (16)
+#endif
+
+typedef enum
+{
+    replay_output_binary,
+    replay_output_csv
+} replay_output_t;
+
+/* PCM stream of the WAV file */
+typedef struct {
+    FILE* file;
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint32_t frames_left;
+} wav_reader_t;
+
+#if MEASURE_LATENCY == 1
+/* Response of the LEDs to the clicks of impulse input */
+typedef struct {
+    /* Kick whose response is waited for */
+    uint32_t click;
+    /* Sum of LED levels of the last frame before the click */
+    uint32_t baseline;
+    uint32_t failures;
+} impulse_check_t;
+#endif
+
+/* Latest fft_size samples, oldest one is at write_index */
+static int16_t window[FFT_MAX_SIZE];
+static size_t window_write_index = 0;
+static size_t window_filled = 0;
+
+static int16_t block[AUDIO_CAPTURE_BLOCK_SIZE];
+static fft_work_t fft_work[(FFT_MAX_SIZE > BASS_FFT_SIZE) ? FFT_WORK_SIZE(FFT_MAX_SIZE) : FFT_WORK_SIZE(BASS_FFT_SIZE)];
+static float fft_res[FFT_MAX_SIZE];
+static float bass_res[BASS_FFT_SIZE];
+static size_t spectrum_size = 0;
+static bool spectrum_ready = false;
+/* FFT size is fixed for the whole replay, so songs can be compared at every size */
+static size_t fft_size = FFT_SIZE;
+static fft_instance_t* fft_plan;
+static fft_dc_tracker_t fft_dc_tracker;
+static sliding_dft_t rgb_sliding_dft;
+static beat_detector_t beat_detector;
+static beat_info_t beat;
+
+/* Free running timer of trace timestamps, counts audio time */
+static cyhal_timer_t timer_obj;
+#if BASS_ANALYSIS == 1
+static fft_instance_t* bass_fft_plan;
+static decimator_t bass_decimator;
+static fft_dc_tracker_t bass_dc_tracker;
+#endif
+
+/* SPI data of the current frame, one segment per strip */
+static uint8_t spi_frame[WS2812_STRIPS_COUNT][1 + (WS2812_STRIP_LEDS * WS2812_BYTES_PER_PIXEL * 3)];
+static size_t spi_frame_length[WS2812_STRIPS_COUNT];
+static uint8_t frame_colors[WS2812_LEDS_COUNT * 3];
+
+static int wav_open(wav_reader_t* wav, const char* path);
+static size_t wav_read_block(wav_reader_t* wav, int16_t* samples, size_t count);
+static void spi_sink(cyhal_gpio_t mosi, const uint8_t* data, size_t length);
+static int decode_frame(void);
+static void analyse_block(visualization_mode_t mode, uint32_t* active_needs);
+static void merge_bins(size_t* first_bin, size_t* bins_count, size_t other_first_bin, size_t other_bins_count);
+static void write_frame(FILE* out, replay_output_t format, uint32_t frame, double time);
+#if MEASURE_LATENCY == 1
+static uint64_t impulse_onset(uint32_t click);
+static size_t impulse_read_block(uint64_t position, int16_t* samples, size_t count);
+static void impulse_check_frame(impulse_check_t* check, uint64_t frame_ns, uint64_t spectrum_ns);
+#endif
+static void usage(const char* name);
+
+int main(int argc, char** argv)
+{
+    visualization_mode_t mode = VISUALIZATION_MODE_SPECTRUM;
+    replay_output_t format = replay_output_binary;
+    const char* input_path = NULL;
+    const char* output_path = NULL;
+    bool impulse = false;
+    wav_reader_t wav = { 0 };
+    int opt;
+
+    for(opt = 1; opt < argc; opt++)
+    {
+        if((0 == strcmp(argv[opt], "-m")) && ((opt + 1) < argc))
+        {
+            mode = (visualization_mode_t)atoi(argv[++opt]);
+        }
+        else if((0 == strcmp(argv[opt], "-f")) && ((opt + 1) < argc))
+        {
+            fft_size = (size_t)atoi(argv[++opt]);
+        }
+        else if(0 == strcmp(argv[opt], "-c"))
+        {
+            format = replay_output_csv;
+        }
+#if MEASURE_LATENCY == 1
+        else if(0 == strcmp(argv[opt], "-i"))
+        {
+            impulse = true;
+        }
+#endif
+        else if((NULL == input_path) && !impulse)
+        {
+            input_path = argv[opt];
+        }
+        else if(NULL == output_path)
+        {
+            output_path = argv[opt];
+        }
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(((NULL == input_path) && !impulse) || (NULL == output_path) || (mode >= VISUALIZATION_MODE_MAX) ||
+       (fft_size < FFT_MIN_SIZE) || (fft_size > FFT_MAX_SIZE) || (0 != (fft_size & (fft_size - 1))))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if(!impulse)
+    {
+        if(0 != wav_open(&wav, input_path))
+        {
+            return EXIT_FAILURE;
+        }
+
+        /* Pipeline is built for one sample rate, audio is not resampled */
+        if(AUDIO_SAMPLING_RATE != wav.sample_rate)
+        {
+            fprintf(stderr, "%s is %u Hz, only %u Hz is supported\n", input_path, wav.sample_rate,
+                    AUDIO_SAMPLING_RATE);
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE* out = fopen(output_path, "wb");
+    if(NULL == out)
+    {
+        fprintf(stderr, "Can't open %s\n", output_path);
+        return EXIT_FAILURE;
+    }
+
+    /* Same initialisation as app_init() */
+    cyhal_gpio_t strip_pins[WS2812_STRIPS_COUNT];
+    for(size_t i = 0; i < WS2812_STRIPS_COUNT; i++)
+    {
+        strip_pins[i] = (cyhal_gpio_t)i;
+    }
+    cyhal_host_spi_set_sink(spi_sink);
+    cyhal_host_set_time(0);
+
+    uint16_t tracked_bins[SLIDING_DFT_MAX_BINS];
+    size_t tracked_bins_count = visualize_get_tracked_bins(FFT_SIZE_HALF, tracked_bins, SLIDING_DFT_MAX_BINS);
+    if((CY_RSLT_SUCCESS != cyhal_timer_init(&timer_obj, NC, NULL)) ||
+       (trace_success != trace_init(&timer_obj)) ||
+       (ws2812_success != ws2812_init(strip_pins)) ||
+       (ARM_MATH_SUCCESS != fft_plans_init()) ||
+       (sliding_dft_success != sliding_dft_init(&rgb_sliding_dft, tracked_bins, tracked_bins_count)) ||
+       (beat_detector_success != beat_detector_init(&beat_detector, fft_size, AUDIO_SAMPLING_RATE,
+                                                    (float)AUDIO_SAMPLING_RATE / AUDIO_HOP_SIZE)) ||
+#if BASS_ANALYSIS == 1
+       (decimator_success != decimator_init(&bass_decimator)) ||
+#endif
+       (visualizer_success != visualize_init(AUDIO_SAMPLING_RATE)))
+    {
+        fprintf(stderr, "Pipeline init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    fft_plan = fft_get_plan(fft_size);
+#if BASS_ANALYSIS == 1
+    bass_fft_plan = fft_get_plan(BASS_FFT_SIZE);
+#endif
+
+    if(replay_output_binary == format)
+    {
+        uint32_t header[3] = { REPLAY_FORMAT_VERSION, WS2812_LEDS_COUNT, FRAME_RATE_FPS };
+        fwrite(REPLAY_MAGIC, 1, 4, out);
+        fwrite(header, sizeof(header), 1, out);
+    }
+    else
+    {
+        fprintf(out, "frame,time_s");
+        for(size_t i = 0; i < WS2812_LEDS_COUNT; i++)
+        {
+            fprintf(out, ",r%zu,g%zu,b%zu", i, i, i);
+        }
+        fprintf(out, "\n");
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    uint64_t samples = 0;
+    uint32_t deadlines = 0;
+    uint32_t frames = 0;
+    uint32_t stale_frames = 0;
+    uint32_t active_needs = 0;
+    bool fresh = false;
+#if MEASURE_LATENCY == 1
+    uint64_t spectrum_samples = 0;
+    uint32_t spectrum_timestamp = 0;
+    impulse_check_t check = { 0 };
+#endif
+
+    for(;;)
+    {
+#if MEASURE_LATENCY == 1
+        size_t read = impulse ? impulse_read_block(samples, block, AUDIO_CAPTURE_BLOCK_SIZE) :
+                                wav_read_block(&wav, block, AUDIO_CAPTURE_BLOCK_SIZE);
+#else
+        size_t read = wav_read_block(&wav, block, AUDIO_CAPTURE_BLOCK_SIZE);
+#endif
+        if(AUDIO_CAPTURE_BLOCK_SIZE != read)
+        {
+            break;
+        }
+
+        /* Block is captured together with its last sample */
+        samples += AUDIO_CAPTURE_BLOCK_SIZE;
+        cyhal_host_set_time(REPLAY_SAMPLES_TO_NS(samples));
+
+        analyse_block(mode, &active_needs);
+        if(spectrum_ready)
+        {
+            fresh = true;
+#if MEASURE_LATENCY == 1
+            spectrum_samples = samples;
+            spectrum_timestamp = trace_get_timestamp();
+#endif
+        }
+
+        /* Frames due before the next block is captured draw the latest spectrum the same
+         * as render task does at its deadlines, nothing is drawn before the first one.
+         * With one block windows it is ready with the first block, deadlines that passed
+         * before that block was captured are skipped too */
+        for(; ((uint64_t)deadlines * AUDIO_SAMPLING_RATE) < ((samples + AUDIO_CAPTURE_BLOCK_SIZE) * FRAME_RATE_FPS);
+            deadlines++)
+        {
+            if(!spectrum_ready || (((uint64_t)deadlines * AUDIO_SAMPLING_RATE) < (samples * FRAME_RATE_FPS)))
+            {
+                continue;
+            }
+
+            uint64_t frame_ns = ((uint64_t)deadlines * 1000000000u) / FRAME_RATE_FPS;
+            cyhal_host_set_time(frame_ns);
+
+#if MEASURE_LATENCY == 1
+            if(fresh)
+            {
+                ws2812_set_frame_timestamp(spectrum_timestamp);
+            }
+#endif
+
+            memset(spi_frame_length, 0, sizeof(spi_frame_length));
+#if BASS_ANALYSIS == 1
+            visualize_fft(fft_res, spectrum_size, bass_res, &beat, mode);
+#else
+            visualize_fft(fft_res, spectrum_size, NULL, &beat, mode);
+#endif
+            ws2812_wait_idle();
+            if(0 != decode_frame())
+            {
+                fprintf(stderr, "Unexpected SPI data in frame %u\n", frames);
+                return EXIT_FAILURE;
+            }
+
+#if MEASURE_LATENCY == 1
+            if(impulse && fresh)
+            {
+                impulse_check_frame(&check, frame_ns, REPLAY_SAMPLES_TO_NS(spectrum_samples));
+            }
+#endif
+
+            write_frame(out, format, frames, (double)deadlines / FRAME_RATE_FPS);
+            stale_frames += fresh ? 0 : 1;
+            fresh = false;
+            frames++;
+        }
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + ((end.tv_nsec - start.tv_nsec) / 1e9);
+    double audio_time = (double)samples / AUDIO_SAMPLING_RATE;
+
+    fclose(out);
+    if(!impulse)
+    {
+        fclose(wav.file);
+    }
+
+    printf("Mode %u, %u frames (%u stale) from %.2f s of audio\n", mode, frames, stale_frames, audio_time);
+    printf("Replay took %.3f s, %.1f x real time, %.1f frames/s\n", elapsed,
+           (elapsed > 0) ? (audio_time / elapsed) : 0.0, (elapsed > 0) ? (frames / elapsed) : 0.0);
+
+#if MEASURE_LATENCY == 1
+    latency_stats_t latency_stats;
+    latency_get_stats(&latency_stats);
+    printf("Latency p50 %u us, p95 %u us, p99 %u us, max %u us of %u frames\n", latency_stats.p50,
+           latency_stats.p95, latency_stats.p99, latency_stats.max, latency_stats.count);
+
+    if(impulse)
+    {
+        /* Clicks that were not reached before the end are failures too */
+        check.failures += REPLAY_IMPULSE_COUNT - check.click;
+        printf("Impulse test %s, %u of %u clicks failed\n", (0 == check.failures) ? "passed" : "FAILED",
+               check.failures, REPLAY_IMPULSE_COUNT);
+        if(0 != check.failures)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+#endif
+
+    return EXIT_SUCCESS;
+}
+
+static void analyse_block(visualization_mode_t mode, uint32_t* active_needs)
+{
+    size_t first_bin;
+    size_t bins_count;
+    uint32_t needs = visualize_get_needs(mode);
+    uint32_t started_needs = needs & ~(*active_needs);
+    *active_needs = needs;
+
+    if(0 != (needs & VISUALIZE_NEEDS_TRACKED_BINS))
+    {
+        if(0 != (started_needs & VISUALIZE_NEEDS_TRACKED_BINS))
+        {
+            sliding_dft_reset(&rgb_sliding_dft);
+        }
+        sliding_dft_process(&rgb_sliding_dft, block, AUDIO_CAPTURE_BLOCK_SIZE);
+    }
+
+    if(0 != (started_needs & VISUALIZE_NEEDS_BEAT))
+    {
+        beat_detector_reset(&beat_detector);
+    }
+
+#if BASS_ANALYSIS == 1
+    if(0 != (needs & VISUALIZE_NEEDS_BASS_SPECTRUM))
+    {
+        if(0 != (started_needs & VISUALIZE_NEEDS_BASS_SPECTRUM))
+        {
+            decimator_reset(&bass_decimator);
+        }
+        decimator_process(&bass_decimator, block);
+    }
+#endif
+
+    /* Append block to the window */
+    for(size_t i = 0; i < AUDIO_CAPTURE_BLOCK_SIZE; i++)
+    {
+        window[window_write_index] = block[i];
+        window_write_index = (window_write_index + 1) % fft_size;
+    }
+    if(window_filled < fft_size)
+    {
+        window_filled += AUDIO_CAPTURE_BLOCK_SIZE;
+        if(window_filled < fft_size)
+        {
+            return;
+        }
+    }
+
+    if(0 != (needs & VISUALIZE_NEEDS_TRACKED_BINS))
+    {
+        sliding_dft_get_power(&rgb_sliding_dft, fft_res);
+        spectrum_size = rgb_sliding_dft.bins_count;
+    }
+    else if(0 != (needs & (VISUALIZE_NEEDS_SPECTRUM | VISUALIZE_NEEDS_BEAT)))
+    {
+        visualize_get_bins(mode, fft_size / 2, &first_bin, &bins_count);
+        if(0 != (needs & VISUALIZE_NEEDS_BEAT))
+        {
+            size_t beat_first_bin;
+            size_t beat_bins_count;
+            beat_detector_get_bins(&beat_detector, &beat_first_bin, &beat_bins_count);
+            merge_bins(&first_bin, &bins_count, beat_first_bin, beat_bins_count);
+        }
+
+        compute_rfft_split(fft_plan, &window[window_write_index], fft_size - window_write_index, window,
+                           &fft_dc_tracker, fft_work, fft_res, fft_size, first_bin, bins_count);
+        spectrum_size = fft_size / 2;
+
+        if(0 != (needs & VISUALIZE_NEEDS_BEAT))
+        {
+            beat_detector_process(&beat_detector, fft_res, &beat);
+        }
+    }
+    else
+    {
+        spectrum_size = 0;
+    }
+    spectrum_ready = true;
+
+#if BASS_ANALYSIS == 1
+    const int16_t* bass_head;
+    const int16_t* bass_tail;
+    size_t bass_head_length;
+
+    visualize_get_bass_bins(mode, &first_bin, &bins_count);
+    if(0 != bins_count)
+    {
+        if(decimator_success == decimator_get_window(&bass_decimator, &bass_head, &bass_head_length, &bass_tail))
+        {
+            compute_rfft_split(bass_fft_plan, bass_head, bass_head_length, bass_tail, &bass_dc_tracker, fft_work,
+                               bass_res, BASS_FFT_SIZE, first_bin, bins_count);
+        }
+        else
+        {
+            arm_fill_f32(0, &bass_res[first_bin], bins_count);
+        }
+    }
+#endif
+}
+
+/* Extends bin range to cover the other one too, empty ranges are ignored */
+static void merge_bins(size_t* first_bin, size_t* bins_count, size_t other_first_bin, size_t other_bins_count)
+{
+    if(0 == other_bins_count)
+    {
+        return;
+    }
+
+    if(0 == *bins_count)
+    {
+        *first_bin = other_first_bin;
+        *bins_count = other_bins_count;
+        return;
+    }
+
+    size_t end_bin = *first_bin + *bins_count;
+    size_t other_end_bin = other_first_bin + other_bins_count;
+
+    *first_bin = (other_first_bin < *first_bin) ? other_first_bin : *first_bin;
+    *bins_count = ((other_end_bin > end_bin) ? other_end_bin : end_bin) - *first_bin;
+}
+
+/* Reads 16-bit PCM, channels are mixed down and samples are scaled
+ * to signed values of AUDIO_SAMPLE_BITS the same as ADC gives */
+static size_t wav_read_block(wav_reader_t* wav, int16_t* samples, size_t count)
+{
+    int16_t pcm[2];
+    size_t read = 0;
+
+    while((read < count) && (0 != wav->frames_left))
+    {
+        if(wav->channels != fread(pcm, sizeof(pcm[0]), wav->channels, wav->file))
+        {
+            break;
+        }
+
+        int32_t sum = 0;
+        for(size_t ch = 0; ch < wav->channels; ch++)
+        {
+            sum += pcm[ch];
+        }
+        samples[read++] = (sum / wav->channels) >> (16 - AUDIO_SAMPLE_BITS);
+        wav->frames_left--;
+    }
+
+    return read;
+}
+
+static int wav_open(wav_reader_t* wav, const char* path)
+{
+    char id[4];
+    uint32_t size;
+    uint16_t format = 0;
+    uint16_t bits = 0;
+
+    wav->file = fopen(path, "rb");
+    if(NULL == wav->file)
+    {
+        fprintf(stderr, "Can't open %s\n", path);
+        return -1;
+    }
+
+    if((1 != fread(id, 4, 1, wav->file)) || (0 != memcmp(id, WAV_RIFF_ID, 4)) ||
+       (1 != fread(&size, 4, 1, wav->file)) ||
+       (1 != fread(id, 4, 1, wav->file)) || (0 != memcmp(id, WAV_WAVE_ID, 4)))
+    {
+        fprintf(stderr, "%s is not a WAV file\n", path);
+        return -1;
+    }
+
+    /* Walk chunks until data, fmt has to come before it */
+    wav->channels = 0;
+    wav->sample_rate = 0;
+    while((1 == fread(id, 4, 1, wav->file)) && (1 == fread(&size, 4, 1, wav->file)))
+    {
+        if(0 == memcmp(id, WAV_FMT_ID, 4))
+        {
+            uint8_t fmt[16];
+            if((size < sizeof(fmt)) || (1 != fread(fmt, sizeof(fmt), 1, wav->file)))
+            {
+                break;
+            }
+            memcpy(&format, &fmt[0], 2);
+            memcpy(&wav->channels, &fmt[2], 2);
+            memcpy(&wav->sample_rate, &fmt[4], 4);
+            memcpy(&bits, &fmt[14], 2);
+            fseek(wav->file, (size - sizeof(fmt)) + (size & 1), SEEK_CUR);
+        }
+        else if(0 == memcmp(id, WAV_DATA_ID, 4))
+        {
+            if((WAV_FORMAT_PCM != format) || (16 != bits) || (0 == wav->channels) || (wav->channels > 2))
+            {
+                fprintf(stderr, "%s: only 16-bit PCM mono or stereo is supported\n", path);
+                return -1;
+            }
+            wav->frames_left = size / (wav->channels * sizeof(int16_t));
+            return 0;
+        }
+        else
+        {
+            fseek(wav->file, size + (size & 1), SEEK_CUR);
+        }
+    }
+
+    fprintf(stderr, "%s has no audio data\n", path);
+    return -1;
+}
+
+/* Collects SPI data of every strip, strips are told apart by MOSI pin */
+static void spi_sink(cyhal_gpio_t mosi, const uint8_t* data, size_t length)
+{
+    size_t strip = (size_t)mosi;
+
+    if((strip < WS2812_STRIPS_COUNT) && ((spi_frame_length[strip] + length) <= sizeof(spi_frame[strip])))
+    {
+        memcpy(&spi_frame[strip][spi_frame_length[strip]], data, length);
+        spi_frame_length[strip] += length;
+    }
+}
+
+/* Turns SPI data back to colours. Every colour bit is sent as 3 SPI bits,
+ * 110 is one and 100 is zero, LEDs take green, red and blue */
+static int decode_frame(void)
+{
+    const size_t led_bytes = 9;
+
+    for(size_t strip = 0; strip < WS2812_STRIPS_COUNT; strip++)
+    {
+        if(spi_frame_length[strip] != (1 + (WS2812_STRIP_LEDS * led_bytes)))
+        {
+            return -1;
+        }
+
+        for(size_t led = 0; led < WS2812_STRIP_LEDS; led++)
+        {
+            const uint8_t* code = &spi_frame[strip][1 + (led * led_bytes)];
+            uint8_t grb[3];
+
+            for(size_t color = 0; color < 3; color++)
+            {
+                uint32_t bits = (code[color * 3] << 16) | (code[(color * 3) + 1] << 8) | code[(color * 3) + 2];
+                uint8_t value = 0;
+
+                for(int bit = 7; bit >= 0; bit--)
+                {
+                    uint32_t symbol = (bits >> (bit * 3)) & 0x7;
+                    if((0x6 != symbol) && (0x4 != symbol))
+                    {
+                        return -1;
+                    }
+                    value = (value << 1) | ((0x6 == symbol) ? 1 : 0);
+                }
+                grb[color] = value;
+            }
+
+            uint8_t* rgb = &frame_colors[((strip * WS2812_STRIP_LEDS) + led) * 3];
+            rgb[0] = grb[1];
+            rgb[1] = grb[0];
+            rgb[2] = grb[2];
+        }
+    }
+
+    return 0;
+}
+
+static void write_frame(FILE* out, replay_output_t format, uint32_t frame, double time)
+{
+    if(replay_output_binary == format)
+    {
+        fwrite(frame_colors, sizeof(frame_colors), 1, out);
+        return;
+    }
+
+    fprintf(out, "%u,%.4f", frame, time);
+    for(size_t i = 0; i < sizeof(frame_colors); i++)
+    {
+        fprintf(out, ",%u", frame_colors[i]);
+    }
+    fprintf(out, "\n");
+}
+
+#if MEASURE_LATENCY == 1
+/* First sample of the click, clicks start in the middle of their
+ * period at the beginning of a capture block */
+static uint64_t impulse_onset(uint32_t click)
+{
+    uint64_t middle = ((uint64_t)click * REPLAY_IMPULSE_PERIOD) + (REPLAY_IMPULSE_PERIOD / 2);
+    return (middle / AUDIO_CAPTURE_BLOCK_SIZE) * AUDIO_CAPTURE_BLOCK_SIZE;
+}
+
+/* Gives impulse input from the given sample on, silence with clicks */
+static size_t impulse_read_block(uint64_t position, int16_t* samples, size_t count)
+{
+    const uint64_t length = (uint64_t)REPLAY_IMPULSE_COUNT * REPLAY_IMPULSE_PERIOD;
+    size_t read = 0;
+
+    for(; (read < count) && (position < length); read++, position++)
+    {
+        uint64_t onset = impulse_onset(position / REPLAY_IMPULSE_PERIOD);
+        float value = 0;
+
+        if(position >= onset)
+        {
+            /* Noise is the same for every click and every run */
+            uint32_t noise = (uint32_t)(position - onset) * 2654435761u;
+            float time = (float)(position - onset) / AUDIO_SAMPLING_RATE;
+            value = REPLAY_IMPULSE_AMPLITUDE * expf(-time / REPLAY_IMPULSE_DECAY) *
+                    (((float)(noise >> 8) / (1u << 23)) - 1.0f);
+        }
+        samples[read] = (int16_t)value;
+    }
+
+    return read;
+}
+
+/* First frame after the click that is brighter than the last one before it is the
+ * response. Latency recorded for it when it was sent must be the time from the capture
+ * of the newest block of its spectrum, which is known here from audio time */
+static void impulse_check_frame(impulse_check_t* check, uint64_t frame_ns, uint64_t spectrum_ns)
+{
+    latency_stats_t latency_stats;
+    uint32_t level = 0;
+
+    if(check->click >= REPLAY_IMPULSE_COUNT)
+    {
+        return;
+    }
+
+    for(size_t i = 0; i < sizeof(frame_colors); i++)
+    {
+        level += frame_colors[i];
+    }
+
+    uint64_t onset_ns = REPLAY_SAMPLES_TO_NS(impulse_onset(check->click));
+    if(frame_ns < onset_ns)
+    {
+        check->baseline = level;
+        return;
+    }
+
+    if(level >= (check->baseline + REPLAY_IMPULSE_MIN_RISE))
+    {
+        uint32_t expected = (uint32_t)((frame_ns / 1000u) - (spectrum_ns / 1000u));
+        latency_get_stats(&latency_stats);
+
+        printf("Click %u at %.3f s: light after %u us, measured latency %u us (expected %u us)\n", check->click,
+               onset_ns / 1e9, (uint32_t)((frame_ns - onset_ns) / 1000u), latency_stats.last, expected);
+        if(latency_stats.last != expected)
+        {
+            check->failures++;
+        }
+        check->click++;
+    }
+    else if(frame_ns >= (onset_ns + REPLAY_SAMPLES_TO_NS(REPLAY_IMPULSE_PERIOD / 2)))
+    {
+        printf("Click %u at %.3f s: no response\n", check->click, onset_ns / 1e9);
+        check->failures++;
+        check->click++;
+    }
+}
+#endif
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [-m mode] [-f size] [-c] input.wav output\n", name);
+#if MEASURE_LATENCY == 1
+    fprintf(stderr, "       %s [-m mode] [-f size] [-c] -i output\n", name);
+#endif
+    fprintf(stderr, "  -m mode  visualization mode, 0 - %u (default %u)\n", VISUALIZATION_MODE_MAX - 1,
+            VISUALIZATION_MODE_SPECTRUM);
+    fprintf(stderr, "  -f size  FFT size, power of 2 from %u to %u (default %u)\n", FFT_MIN_SIZE, FFT_MAX_SIZE,
+            FFT_SIZE);
+    fprintf(stderr, "  -c       write CSV instead of binary frames\n");
+#if MEASURE_LATENCY == 1
+    fprintf(stderr, "  -i       replay clicks instead of a WAV file and check their latency\n");
+#endif
+}
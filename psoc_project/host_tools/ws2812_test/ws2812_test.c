@@ -0,0 +1,420 @@
+/* Host test of the ws2812 driver. SPI data of the lookup table encoder
+ * is checked against the original per-bit encoder for every colour value
+ * and for whole frames sent by ws2812_update(). SPI transfers are then held
+ * to check that frame buffers swap, that the frame being sent is not changed
+ * by drawing or by brightness change and that ws2812_wait_idle() and
+ * ws2812_update() wait for it.
+ * Exit status is non-zero if any check fails */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ws2812.c"
+
+/* Every strip is sent through the SPI block of its own MOSI pin */
+#define TEST_STRIP_DATA_SIZE    (WS_ZERO_OFFSET + (WS2812_STRIP_LEDS * WS_ENCODED_PIXEL_SIZE))
+
+/* SPI data received by the sink since the last reset, one buffer per strip */
+static uint8_t sent_data[WS2812_STRIPS_COUNT][TEST_STRIP_DATA_SIZE];
+static size_t sent_length[WS2812_STRIPS_COUNT];
+static bool sent_overflow = false;
+
+/* SPI data the LEDs are expected to get */
+static uint8_t expected_data[WS2812_STRIPS_COUNT][TEST_STRIP_DATA_SIZE];
+
+static uint32_t failures = 0;
+
+/* Number of times a semaphore take would block */
+static uint32_t blocked_takes = 0;
+
+static void spi_sink(cyhal_gpio_t mosi, const uint8_t* data, size_t length);
+static void sent_reset(void);
+static uint32_t reference_code(uint8_t input);
+static void reference_pixel(uint8_t* dst, uint8_t red, uint8_t green, uint8_t blue);
+static void expect_leds(const led_color_t* colors, uint16_t first, uint16_t count);
+static void block_hook(SemaphoreHandle_t semaphore);
+static void check_sent_frame(const char* name);
+static void check(bool condition, const char* name);
+static void test_code_table(void);
+static void test_encode_pixel(void);
+static void test_set_leds_frames(void);
+static void test_idle_semaphore(void);
+static void test_partial_update(void);
+static void test_brightness_during_transfer(void);
+
+int main(void)
+{
+    cyhal_gpio_t strip_pins[WS2812_STRIPS_COUNT];
+    for(size_t i = 0; i < WS2812_STRIPS_COUNT; i++)
+    {
+        strip_pins[i] = (cyhal_gpio_t)i;
+    }
+
+    cyhal_host_spi_set_sink(spi_sink);
+    freertos_host_set_block_hook(block_hook);
+    if(ws2812_success != ws2812_init(strip_pins))
+    {
+        fprintf(stderr, "ws2812_init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    test_code_table();
+    test_encode_pixel();
+    test_set_leds_frames();
+    test_idle_semaphore();
+    test_partial_update();
+    test_brightness_during_transfer();
+
+    if(0 != failures)
+    {
+        printf("ws2812 test failed, %u checks failed\n", (unsigned)failures);
+        return EXIT_FAILURE;
+    }
+
+    printf("ws2812 test passed\n");
+    return EXIT_SUCCESS;
+}
+
+/* Code table is built at compile time by WS_CODE() */
+static void test_code_table(void)
+{
+    bool match = true;
+
+    for(size_t value = 0; value < 256; value++)
+    {
+        if((ws_code_table[value] & 0x00FFFFFFu) != reference_code(value))
+        {
+            printf("  code of %u is 0x%06x, expected 0x%06x\n", (unsigned)value,
+                   (unsigned)(ws_code_table[value] & 0x00FFFFFFu), (unsigned)reference_code(value));
+            match = false;
+        }
+    }
+
+    check(match, "code table matches per-bit encoder");
+}
+
+static void test_encode_pixel(void)
+{
+    uint8_t encoded[WS_ENCODED_PIXEL_SIZE];
+    uint8_t reference[WS_ENCODED_PIXEL_SIZE];
+    bool match = true;
+
+    for(size_t value = 0; value < 256; value++)
+    {
+        uint8_t red = value;
+        uint8_t green = value + 85;
+        uint8_t blue = value + 170;
+
+        ws_encode_pixel(encoded, red, green, blue);
+        reference_pixel(reference, red, green, blue);
+        if(0 != memcmp(encoded, reference, WS_ENCODED_PIXEL_SIZE))
+        {
+            printf("  pixel of %u differs\n", (unsigned)value);
+            match = false;
+        }
+    }
+
+    check(match, "ws_encode_pixel matches per-bit encoder");
+}
+
+/* Frames are shifted so that every colour value of every channel is sent */
+static void test_set_leds_frames(void)
+{
+    led_color_t colors[WS2812_LEDS_COUNT];
+    char name[64];
+
+    for(size_t shift = 0; shift < 256; shift += 64)
+    {
+        for(size_t i = 0; i < WS2812_LEDS_COUNT; i++)
+        {
+            colors[i].r = i + shift;
+            colors[i].g = (i * 3) + shift;
+            colors[i].b = 255 - (i + shift);
+        }
+
+        ws2812_set_leds(colors, 0, WS2812_LEDS_COUNT);
+#if WS2812_STREAMING_ENCODER == 0
+        /* Encoded when set, with dither of the frame that is drawn */
+        expect_leds(colors, 0, WS2812_LEDS_COUNT);
+#endif
+        sent_reset();
+        ws2812_update();
+#if WS2812_STREAMING_ENCODER == 1
+        /* Encoded while sent, with dither of the frame that is sent */
+        expect_leds(colors, 0, WS2812_LEDS_COUNT);
+#endif
+        ws2812_wait_idle();
+
+        snprintf(name, sizeof(name), "ws2812_set_leds frame shifted by %u", (unsigned)shift);
+        check_sent_frame(name);
+    }
+}
+
+/* Semaphore is taken while a frame is sent and given back when it completes */
+static void test_idle_semaphore(void)
+{
+    led_color_t colors[WS2812_LEDS_COUNT];
+
+    for(size_t i = 0; i < WS2812_LEDS_COUNT; i++)
+    {
+        colors[i].r = 255 - i;
+        colors[i].g = i;
+        colors[i].b = i * 5;
+    }
+
+    ws2812_set_leds(colors, 0, WS2812_LEDS_COUNT);
+#if WS2812_STREAMING_ENCODER == 0
+    expect_leds(colors, 0, WS2812_LEDS_COUNT);
+#endif
+    sent_reset();
+    cyhal_host_spi_hold(true);
+    ws2812_update();
+#if WS2812_STREAMING_ENCODER == 1
+    expect_leds(colors, 0, WS2812_LEDS_COUNT);
+#endif
+
+    check(0 == sent_length[0], "frame is not sent before transfer completes");
+    check(pdFALSE == xSemaphoreTake(ws_idle_semaphore, 0), "idle semaphore is taken during transfer");
+
+    /* Only the SPI IRQ can release it */
+    blocked_takes = 0;
+    ws2812_wait_idle();
+    check(1 == blocked_takes, "ws2812_wait_idle blocks until transfer completes");
+    check_sent_frame("frame sent while held");
+
+    check(pdTRUE == xSemaphoreTake(ws_idle_semaphore, 0), "idle semaphore is given back");
+    xSemaphoreGive(ws_idle_semaphore);
+
+    blocked_takes = 0;
+    ws2812_wait_idle();
+    check(0 == blocked_takes, "ws2812_wait_idle doesn't block when idle");
+
+    cyhal_host_spi_hold(false);
+}
+
+/* Drawing goes to the back buffer while the front one is sent, LEDs that
+ * are not set again keep the colour of the previous frame */
+static void test_partial_update(void)
+{
+    led_color_t colors[WS2812_LEDS_COUNT];
+    const uint16_t changed_first = WS2812_LEDS_COUNT / 3;
+    const uint16_t changed_count = WS2812_LEDS_COUNT / 4;
+
+    for(size_t i = 0; i < WS2812_LEDS_COUNT; i++)
+    {
+        colors[i].r = i * 7;
+        colors[i].g = 255 - (i * 3);
+        colors[i].b = i;
+    }
+
+    cyhal_host_spi_hold(true);
+
+    ws2812_set_leds(colors, 0, WS2812_LEDS_COUNT);
+#if WS2812_STREAMING_ENCODER == 0
+    uint8_t* drawn_buffer = ws_frame_buffer;
+    uint8_t* sent_buffer = ws_front_buffer;
+
+    expect_leds(colors, 0, WS2812_LEDS_COUNT);
+    sent_reset();
+    ws2812_update();
+    check((ws_front_buffer == drawn_buffer) && (ws_frame_buffer == sent_buffer), "ws2812_update swaps buffers");
+
+    /* Part of the next frame is drawn while the first one is still sent */
+    for(size_t i = changed_first; i < (changed_first + changed_count); i++)
+    {
+        colors[i].r = 255 - colors[i].r;
+        colors[i].b = 128;
+    }
+    ws2812_set_leds(&colors[changed_first], changed_first, changed_count);
+    check(0 != memcmp(ws_frame_buffer, ws_front_buffer, WS_FRAME_SIZE),
+          "drawing changes only the back buffer");
+
+    cyhal_host_spi_complete();
+    check_sent_frame("frame sent while the next one is drawn");
+
+    expect_leds(colors, changed_first, changed_count);
+    sent_reset();
+    ws2812_update();
+#else
+    sent_reset();
+    ws2812_update();
+    expect_leds(colors, 0, WS2812_LEDS_COUNT);
+
+    /* Frame is read by the encoder until it is sent, so drawing waits for it */
+    for(size_t i = changed_first; i < (changed_first + changed_count); i++)
+    {
+        colors[i].r = 255 - colors[i].r;
+        colors[i].b = 128;
+    }
+    blocked_takes = 0;
+    ws2812_set_leds(&colors[changed_first], changed_first, changed_count);
+    check(1 == blocked_takes, "drawing waits for the frame to be sent");
+    check_sent_frame("frame sent before the next one is drawn");
+
+    sent_reset();
+    ws2812_update();
+    expect_leds(colors, 0, WS2812_LEDS_COUNT);
+#endif
+
+    /* Update of the next frame waits for the partially updated one */
+    blocked_takes = 0;
+    ws2812_update();
+    check(1 == blocked_takes, "ws2812_update waits for the previous frame");
+    check_sent_frame("partially updated frame");
+
+#if WS2812_STREAMING_ENCODER == 1
+    expect_leds(colors, 0, WS2812_LEDS_COUNT);
+#endif
+    sent_reset();
+    cyhal_host_spi_complete();
+    check_sent_frame("frame without changes");
+
+    cyhal_host_spi_hold(false);
+}
+
+/* Streaming encoder reads brightness table from SPI IRQ, so the change
+ * waits for the frame, encoded frame is not affected by it at all */
+static void test_brightness_during_transfer(void)
+{
+    led_color_t colors[WS2812_LEDS_COUNT];
+
+    for(size_t i = 0; i < WS2812_LEDS_COUNT; i++)
+    {
+        colors[i].r = i;
+        colors[i].g = 200;
+        colors[i].b = 255 - i;
+    }
+
+    ws2812_set_leds(colors, 0, WS2812_LEDS_COUNT);
+#if WS2812_STREAMING_ENCODER == 0
+    expect_leds(colors, 0, WS2812_LEDS_COUNT);
+#endif
+    sent_reset();
+    cyhal_host_spi_hold(true);
+    ws2812_update();
+#if WS2812_STREAMING_ENCODER == 1
+    expect_leds(colors, 0, WS2812_LEDS_COUNT);
+#endif
+
+    blocked_takes = 0;
+    ws2812_set_brightness(WS2812_BRIGHTNESS / 2);
+#if WS2812_STREAMING_ENCODER == 1
+    check(1 == blocked_takes, "brightness change waits for the frame");
+#else
+    check(0 == blocked_takes, "brightness change doesn't wait for the frame");
+    cyhal_host_spi_complete();
+#endif
+    check_sent_frame("frame keeps brightness it was started with");
+
+    ws2812_set_brightness(WS2812_BRIGHTNESS);
+    cyhal_host_spi_hold(false);
+}
+
+/* Every take that would block is released by completing pending transfers,
+ * as SPI IRQ would do on target */
+static void block_hook(SemaphoreHandle_t semaphore)
+{
+    (void)semaphore;
+    blocked_takes++;
+    cyhal_host_spi_complete();
+}
+
+/* Data of every strip is appended, streaming encoder sends it in chunks */
+static void spi_sink(cyhal_gpio_t mosi, const uint8_t* data, size_t length)
+{
+    size_t strip = (size_t)mosi;
+
+    if((strip >= WS2812_STRIPS_COUNT) || ((sent_length[strip] + length) > TEST_STRIP_DATA_SIZE))
+    {
+        sent_overflow = true;
+        return;
+    }
+
+    memcpy(&sent_data[strip][sent_length[strip]], data, length);
+    sent_length[strip] += length;
+}
+
+static void sent_reset(void)
+{
+    memset(sent_length, 0, sizeof(sent_length));
+    sent_overflow = false;
+}
+
+/* Original encoder the lookup table replaced, 1 -> 110 and 0 -> 100 */
+static uint32_t reference_code(uint8_t input)
+{
+    uint32_t ret_val = 0;
+    for(size_t i = 0; i < 8; i++)
+    {
+        if(input % 2)
+        {
+            ret_val |= WS_ONE_CODE;
+        }
+        else
+        {
+            ret_val |= WS_ZERO_CODE;
+        }
+
+        ret_val = ret_val >> 3;
+
+        input = input >> 1;
+    }
+
+    return ret_val;
+}
+
+/* Green, red and blue codes, MSB first */
+static void reference_pixel(uint8_t* dst, uint8_t red, uint8_t green, uint8_t blue)
+{
+    const uint8_t values[WS_COLOR_PER_PIXEL] = { green, red, blue };
+
+    for(size_t i = 0; i < WS_COLOR_PER_PIXEL; i++)
+    {
+        uint32_t code = reference_code(values[i]);
+        dst[(i * WS_SPI_BIT_PER_BIT) + 0] = code >> 16;
+        dst[(i * WS_SPI_BIT_PER_BIT) + 1] = code >> 8;
+        dst[(i * WS_SPI_BIT_PER_BIT) + 2] = code;
+    }
+}
+
+/* Every strip starts with zero byte, LEDs follow with gamma,
+ * brightness and dither of the current frame applied */
+static void expect_leds(const led_color_t* colors, uint16_t first, uint16_t count)
+{
+    for(size_t led = first; led < (size_t)(first + count); led++)
+    {
+        size_t strip = led / WS2812_STRIP_LEDS;
+        uint8_t* dst = &expected_data[strip][WS_ZERO_OFFSET + ((led % WS2812_STRIP_LEDS) * WS_ENCODED_PIXEL_SIZE)];
+        uint8_t dither = ws_dither(led);
+
+        expected_data[strip][0] = 0x00;
+        reference_pixel(dst, (ws_level_table[colors[led].r] + dither) >> WS_LEVEL_SHIFT,
+                        (ws_level_table[colors[led].g] + dither) >> WS_LEVEL_SHIFT,
+                        (ws_level_table[colors[led].b] + dither) >> WS_LEVEL_SHIFT);
+    }
+}
+
+static void check_sent_frame(const char* name)
+{
+    bool match = !sent_overflow;
+
+    for(size_t strip = 0; strip < WS2812_STRIPS_COUNT; strip++)
+    {
+        if((TEST_STRIP_DATA_SIZE != sent_length[strip]) ||
+           (0 != memcmp(sent_data[strip], expected_data[strip], TEST_STRIP_DATA_SIZE)))
+        {
+            printf("  strip %u got %u bytes\n", (unsigned)strip, (unsigned)sent_length[strip]);
+            match = false;
+        }
+    }
+
+    check(match, name);
+}
+
+static void check(bool condition, const char* name)
+{
+    printf("%-48s %s\n", name, condition ? "ok" : "FAILED");
+    if(!condition)
+    {
+        failures++;
+    }
+}
@@ -4,24 +4,213 @@
 /* Number of LEDs */
 #define WS2812_LEDS_COUNT   (30 * 6)
 
-/* Pin to which ws2812 data line is connected */
-#define WS2812_LEDS_PIN     (CYBSP_A0)
+/* LEDs are split into equal strips, each driven by its own SPI block,
+ * so frame transfer time depends only on the length of one strip.
+ * Logical LED index runs through strips one after another */
+#define WS2812_STRIPS_COUNT (1)
+#define WS2812_STRIP_LEDS   (WS2812_LEDS_COUNT / WS2812_STRIPS_COUNT)
 
-/* FFT_SIZE Must be a power of 2 in range from 16 to 4096 */
-#define FFT_SIZE            (1024)
-#define FFT_SIZE_HALF       (FFT_SIZE / 2)
+/* Pins to which ws2812 data lines are connected, one per strip.
+ * Every pin must be a MOSI of a different SCB */
+#define WS2812_STRIP_PINS   { CYBSP_A0 }
+
+#if (WS2812_LEDS_COUNT % WS2812_STRIPS_COUNT) != 0
+#error "WS2812_LEDS_COUNT must be a multiple of WS2812_STRIPS_COUNT"
+#endif
+
+/* LEDs form a panel of LED_MATRIX_HEIGHT rows of LED_MATRIX_WIDTH LEDs. LED 0 is
+ * in the top left corner and the first row runs to the right, with progressive
+ * wiring every row does so, with serpentine wiring every other row runs back.
+ * Drawing area of matrix modes is turned clockwise on the panel by LED_MATRIX_ROTATION
+ * degrees, 0, 90, 180 or 270 */
+#define LED_MATRIX_WIRING_PROGRESSIVE   (0)
+#define LED_MATRIX_WIRING_SERPENTINE    (1)
+
+#define LED_MATRIX_WIDTH    (30)
+#define LED_MATRIX_HEIGHT   (6)
+#define LED_MATRIX_WIRING   (LED_MATRIX_WIRING_SERPENTINE)
+#define LED_MATRIX_ROTATION (0)
+
+#if (LED_MATRIX_WIDTH * LED_MATRIX_HEIGHT) != WS2812_LEDS_COUNT
+#error "LED matrix must have WS2812_LEDS_COUNT LEDs"
+#endif
+
+/* When set to 1 only colours are kept in RAM (3 bytes per LED instead of
+ * 2 x 9 bytes of double buffered SPI data) and SPI data is encoded on the fly
+ * into two chunks per strip, refilled from the transfer complete interrupt.
+ * Drawback is that next frame can't be drawn while previous one is sent */
+#define WS2812_STREAMING_ENCODER    (0)
+
+/* Gamma correction of LED colours, 1.0 keeps them linear */
+#define WS2812_GAMMA                (2.2f)
+
+/* Master brightness applied on top of gamma, 0 - 255 */
+#define WS2812_BRIGHTNESS           (255)
+
+/* When set to 1 fractional part of gamma corrected levels is dithered over
+ * frames, so dim colours get more than 8 bits of resolution. LEDs are dithered
+ * when they are encoded: streaming encoder encodes every LED in every frame,
+ * double buffering only the LEDs set for that frame by ws2812_set_led()
+ * or ws2812_set_leds().
+ * LEDs that are not set again keep their last fraction and ring pixels are
+ * rounded, so dithering works only for patterns that set every LED each frame */
+#define WS2812_DITHERING            (1)
+
+/* Number of LEDs encoded into one streaming chunk. Encoding of a chunk must
+ * take less time than sending one (about 33 us per LED at 2.2 MHz) */
+#define WS2812_STREAM_CHUNK_LEDS    (8)
 
 /* Minimum and maximum supported FFT length */
 #define MIN_SUPPORTED_FFT_SIZE  (32)
 #define MAX_SUPPORTED_FFT_SIZE  (4096)
 
+/* FFT size can be switched at runtime between FFT_SIZES_COUNT powers of 2 from
+ * FFT_MIN_SIZE to FFT_MAX_SIZE, analysis buffers are sized for FFT_MAX_SIZE.
+ * FFT_SIZE is the size used after start, levels of every size are normalised
+ * to it. Without bass analysis FFT_MIN_SIZE / 2 bins without DC must hold SPECTRUM_BANDS_COUNT bands */
+#define FFT_MIN_SIZE        (256)
+#define FFT_SIZES_COUNT     (5)
+#define FFT_MAX_SIZE        (FFT_MIN_SIZE << (FFT_SIZES_COUNT - 1))
+#define FFT_SIZE            (1024)
+#define FFT_SIZE_HALF       (FFT_SIZE / 2)
+
+#if (FFT_MIN_SIZE < MIN_SUPPORTED_FFT_SIZE) || (FFT_MAX_SIZE > MAX_SUPPORTED_FFT_SIZE)
+#error "FFT_MIN_SIZE to FFT_MAX_SIZE must be in the supported range"
+#endif
+
+#if (FFT_SIZE < FFT_MIN_SIZE) || (FFT_SIZE > FFT_MAX_SIZE)
+#error "FFT_SIZE must be in range from FFT_MIN_SIZE to FFT_MAX_SIZE"
+#endif
+
+/* FFT engines */
+#define FFT_ENGINE_F32      (0)
+#define FFT_ENGINE_Q15      (1)
+#define FFT_ENGINE_Q31      (2)
+
+/* Engine used to compute FFT of the audio signal.
+ * Fixed-point engines skip float conversion of the input,
+ * measure_fft_performance() gives accuracy and speed of the selected one */
+#define FFT_ENGINE          (FFT_ENGINE_F32)
+
+/* Window functions */
+#define FFT_WINDOW_HANN     (0)
+#define FFT_WINDOW_BLACKMAN (1)
+
+/* Window applied to FFT input. It is normalised to coherent gain of 1, so a tone
+ * keeps its level, Blackman has lower leakage of loud bins at cost of wider peaks */
+#define FFT_WINDOW          (FFT_WINDOW_HANN)
+
+/* DC offset of the ADC is tracked per input stream and removed from FFT input.
+ * Estimate moves by 1 / 2^FFT_DC_TRACKING_SHIFT of the difference to window mean */
+#define FFT_DC_TRACKING_SHIFT   (7)
+
+/* Analysis engines */
+#define ANALYSIS_ENGINE_FFT         (0)
+#define ANALYSIS_ENGINE_SLIDING_DFT (1)
+
+/* Engine used by RGB and snake modes. They need only energy of three bands,
+ * sliding DFT updates SLIDING_DFT_BINS_PER_BAND bins of every band with each
+ * sample instead of computing full FFT. Spectrum mode always uses FFT */
+#define RGB_MODES_ENGINE            (ANALYSIS_ENGINE_SLIDING_DFT)
+#define SLIDING_DFT_BINS_PER_BAND   (4)
+
 /* Pin to sample audio signal from */
 #define AUDIO_SAMPLING_PIN  (CYBSP_A1)
 
+/* ADC resolution in bits */
+#define AUDIO_SAMPLE_BITS   (12)
+
 /* Sample rate for ADC in Hz */
 #define AUDIO_SAMPLING_RATE (44100)
 
+/* Number of new samples between two consecutive FFTs. Must divide
+ * FFT_MIN_SIZE, FFT_MIN_SIZE gives non-overlapping windows at the smallest size */
+#define AUDIO_HOP_SIZE      (FFT_SIZE / 4)
+
+#if (FFT_MIN_SIZE % AUDIO_HOP_SIZE) != 0
+#error "AUDIO_HOP_SIZE must divide FFT_MIN_SIZE"
+#endif
+
+/* Audio is captured by DMA to a ring of AUDIO_CAPTURE_BLOCKS blocks without gaps,
+ * application gets notified every time one block is filled.
+ * Ring holds the largest FFT window plus two blocks, one that is being
+ * filled by DMA and one spare to tolerate processing jitter */
+#define AUDIO_CAPTURE_BLOCK_SIZE    (AUDIO_HOP_SIZE)
+#define AUDIO_CAPTURE_BLOCKS        ((FFT_MAX_SIZE / AUDIO_HOP_SIZE) + 2)
+
+/* Bass analysis. Audio is low-pass filtered and decimated by BASS_DECIMATION_FACTOR
+ * with a polyphase FIR, so small BASS_FFT_SIZE FFT of the low rate signal has the same
+ * bin width as BASS_FFT_SIZE * BASS_DECIMATION_FACTOR FFT at full rate.
+ * Spectrum analyzer bands below BASS_CROSSOVER_FREQUENCY in Hz are taken from it,
+ * as many of them as the bass bins below it can hold one bin each.
+ * AUDIO_CAPTURE_BLOCK_SIZE and BASS_FIR_TAPS must be multiples of BASS_DECIMATION_FACTOR,
+ * crossover should stay below half of the decimated Nyquist frequency */
+#define BASS_ANALYSIS               (1)
+#define BASS_DECIMATION_FACTOR      (8)
+#define BASS_FIR_TAPS               (64)
+#define BASS_FFT_SIZE               (512)
+#define BASS_CROSSOVER_FREQUENCY    (1000)
+
+#if (BASS_CROSSOVER_FREQUENCY * BASS_DECIMATION_FACTOR * 4) >= AUDIO_SAMPLING_RATE
+#error "BASS_CROSSOVER_FREQUENCY must be below half of the decimated Nyquist frequency"
+#endif
+
+/* Beat detection. Spectral flux of FFT bins from BEAT_MIN_FREQUENCY to BEAT_MAX_FREQUENCY
+ * (Hz), kick drum range by default, is compared with mean plus BEAT_THRESHOLD_SIGMA
+ * standard deviations of flux over the last BEAT_HISTORY_SIZE analysis frames, about one second */
+#define BEAT_MIN_FREQUENCY          (40)
+#define BEAT_MAX_FREQUENCY          (250)
+#define BEAT_HISTORY_SIZE           (AUDIO_SAMPLING_RATE / AUDIO_HOP_SIZE)
+#define BEAT_THRESHOLD_SIGMA        (2.5f)
+
+/* Onsets closer than this are taken as one beat */
+#define BEAT_MIN_INTERVAL_MS        (250)
+
+/* Range of the tempo estimate in beats per minute, beat
+ * intervals are halved or doubled until they fit into it */
+#define BEAT_MIN_BPM                (70)
+#define BEAT_MAX_BPM                (180)
+
+/* Spectra are passed from analysis task to render task in a pool of
+ * preallocated slots: one is filled, one is rendered and one is queued */
+#define SPECTRUM_POOL_SLOTS         (3)
+
+/* Rate at which render task sends LED frames. When analysis has no new
+ * spectrum by the frame deadline the previous one is drawn again */
+#define FRAME_RATE_FPS              (50)
+
+/* Number of log spaced bands of spectrum analyzer, up to WS2812_LEDS_COUNT,
+ * and frequency range in Hz they cover */
+#define SPECTRUM_BANDS_COUNT    (WS2812_LEDS_COUNT)
+#define SPECTRUM_MIN_FREQUENCY  (40.0f)
+#define SPECTRUM_MAX_FREQUENCY  (16000.0f)
+
+/* Bin 0 is DC, so FFT_MIN_SIZE / 2 bins hold one band less than they count */
+#if (BASS_ANALYSIS == 0) && (SPECTRUM_BANDS_COUNT >= (FFT_MIN_SIZE / 2))
+#error "Without bass analysis SPECTRUM_BANDS_COUNT must be below FFT_MIN_SIZE / 2"
+#endif
+
+/* User button press at least BUTTON_LONG_PRESS_MS long switches FFT size, shorter one
+ * switches mode. Releases sooner than BUTTON_DEBOUNCE_MS after press are contact bounce */
+#define BUTTON_LONG_PRESS_MS    (1000)
+#define BUTTON_DEBOUNCE_MS      (30)
+
 /* Whether to measure performance */
 #define MEASURE_PERFORMANCE (1)
 
+/* When set to 1 audio to light latency of every frame is collected to a histogram:
+ * time from the end of capture of the newest audio block the frame was computed from
+ * to the end of its LED transfer. Histogram has LATENCY_BUCKETS buckets, each
+ * LATENCY_BUCKET_US wide, longer latencies are counted in the last one */
+#define MEASURE_LATENCY     (1)
+#define LATENCY_BUCKET_US   (250)
+#define LATENCY_BUCKETS     (256)
+
+/* Number of events in the trace ring, must be a power of 2.
+ * Ring has to hold all events produced between two reports */
+#define TRACE_BUFFER_EVENTS     (512)
+
+/* How often trace report task prints per stage timings */
+#define TRACE_REPORT_PERIOD_MS  (1000)
+
 #endif /* __APP_CONFIG_H__ */
@@ -0,0 +1,331 @@
+#include "audio_capture.h"
+#include "cy_pdl.h"
+/* Free RTOS */
+#include "FreeRTOS.h"
+#include "semphr.h"
+#if (MEASURE_PERFORMANCE == 1) || (MEASURE_LATENCY == 1)
+#include "trace.h"
+#endif
+
+/* DataWire descriptor moves at most 256 elements in its X loop */
+#if AUDIO_CAPTURE_BLOCK_SIZE > 256
+#error "AUDIO_CAPTURE_BLOCK_SIZE must fit one DMA descriptor"
+#endif
+
+/* Sample ring is split into blocks. While DMA fills the next block
+ * other blocks are processed by the application. ADC gives only
+ * AUDIO_SAMPLE_BITS bits, so DMA stores lower half of the result register.
+ *
+ * Every block has its own DMA descriptor and descriptors are chained into
+ * a circle, so DMA moves from one block to the next one by itself and
+ * no sample is lost while the completion IRQ waits to be served.
+ * IRQ only hands filled blocks to the application */
+static int16_t audio_ring[AUDIO_CAPTURE_BLOCKS][AUDIO_CAPTURE_BLOCK_SIZE];
+static cy_stc_dma_descriptor_t audio_descriptors[AUDIO_CAPTURE_BLOCKS];
+
+/* ADC scan complete triggers transfer of one sample by this DMA channel */
+static cyhal_dma_t audio_dma_obj;
+static DW_Type* audio_dma_base = NULL;
+static uint32_t audio_dma_channel = 0;
+
+static cyhal_adc_channel_t* audio_adc_chan_obj = NULL;
+
+/* Block that is currently filled by DMA */
+static volatile uint32_t write_block = 0;
+
+/* Next block that is returned to the application */
+static uint32_t read_block = 0;
+
+/* Number of blocks that are filled but not released by the application yet */
+static volatile uint32_t filled_blocks = 0;
+
+/* Number of blocks returned to the application and not released yet */
+static uint32_t held_blocks = 0;
+
+#if MEASURE_LATENCY == 1
+/* Time at which DMA completed every block of the ring */
+static volatile uint32_t block_timestamps[AUDIO_CAPTURE_BLOCKS];
+
+/* Block returned by the last audio_capture_get_block() call */
+static uint32_t last_block = 0;
+#endif
+
+/* Number of blocks dropped because application was too slow */
+static volatile uint32_t overruns = 0;
+
+/* Counts filled blocks, given from DMA IRQ */
+static SemaphoreHandle_t audio_block_semaphore = NULL;
+static StaticSemaphore_t audio_block_semaphore_buffer;
+
+static void audio_capture_dma_irq_handler(void);
+static void audio_capture_link_next(void);
+
+audio_capture_res_t audio_capture_init(cyhal_adc_channel_t* adc_chan_obj)
+{
+    cy_rslt_t cy_res;
+    cyhal_source_t scan_done;
+
+    audio_adc_chan_obj = adc_chan_obj;
+
+    /* Create semaphore */
+    audio_block_semaphore = xSemaphoreCreateCountingStatic(AUDIO_CAPTURE_BLOCKS, 0, &audio_block_semaphore_buffer);
+    if(NULL == audio_block_semaphore)
+    {
+        return audio_capture_error_generic;
+    }
+
+    /* Every finished scan of continuously scanning ADC triggers one DMA element */
+    cy_res = cyhal_adc_enable_output(adc_chan_obj->adc, CYHAL_ADC_OUTPUT_SCAN_COMPLETE, &scan_done);
+    if(CY_RSLT_SUCCESS != cy_res)
+    {
+        return audio_capture_error_generic;
+    }
+
+    cyhal_dma_src_t dma_src = {
+        .source = scan_done,
+        .input = CYHAL_DMA_INPUT_TRIGGER_SINGLE_ELEMENT
+    };
+    cy_res = cyhal_dma_init_adv(&audio_dma_obj, &dma_src, NULL, NULL, CYHAL_DMA_PRIORITY_DEFAULT,
+                                CYHAL_DMA_DIRECTION_PERIPH2MEM);
+    if(CY_RSLT_SUCCESS != cy_res)
+    {
+        return audio_capture_error_generic;
+    }
+
+    /* HAL only reserves DataWire channel and routes the trigger,
+     * descriptors and IRQ of the channel are set up with PDL */
+    audio_dma_base = (0 == audio_dma_obj.resource.block_num) ? DW0 : DW1;
+    audio_dma_channel = audio_dma_obj.resource.channel_num;
+
+    cy_stc_dma_descriptor_config_t descriptor_cfg = {
+        .retrigger = CY_DMA_RETRIG_4CYC,
+        .interruptType = CY_DMA_DESCR,
+        .triggerOutType = CY_DMA_1ELEMENT,
+        .channelStateOnCompletion = CY_DMA_CHANNEL_ENABLED,
+        .triggerInType = CY_DMA_1ELEMENT,
+        .dataSize = CY_DMA_HALFWORD,
+        .srcTransferSize = CY_DMA_TRANSFER_SIZE_WORD,
+        .dstTransferSize = CY_DMA_TRANSFER_SIZE_DATA,
+        .descriptorType = CY_DMA_1D_TRANSFER,
+        .srcAddress = (void*)&adc_chan_obj->adc->base->CHAN_RESULT[adc_chan_obj->channel_idx],
+        .srcXincrement = 0,
+        .dstXincrement = 1,
+        .xCount = AUDIO_CAPTURE_BLOCK_SIZE,
+        .srcYincrement = 0,
+        .dstYincrement = 0,
+        .yCount = 1
+    };
+
+    for(size_t block = 0; block < AUDIO_CAPTURE_BLOCKS; block++)
+    {
+        descriptor_cfg.dstAddress = audio_ring[block];
+        descriptor_cfg.nextDescriptor = &audio_descriptors[(block + 1) % AUDIO_CAPTURE_BLOCKS];
+        if(CY_DMA_SUCCESS != Cy_DMA_Descriptor_Init(&audio_descriptors[block], &descriptor_cfg))
+        {
+            return audio_capture_error_generic;
+        }
+    }
+
+    cy_stc_dma_channel_config_t channel_cfg = {
+        .descriptor = &audio_descriptors[0],
+        .preemptable = false,
+        .priority = CYHAL_DMA_PRIORITY_DEFAULT,
+        .enable = false,
+        .bufferable = false
+    };
+    if(CY_DMA_SUCCESS != Cy_DMA_Channel_Init(audio_dma_base, audio_dma_channel, &channel_cfg))
+    {
+        return audio_capture_error_generic;
+    }
+
+    cy_stc_sysint_t irq_cfg = {
+        .intrSrc = (IRQn_Type)(((DW0 == audio_dma_base) ? cpuss_interrupts_dw0_0_IRQn : cpuss_interrupts_dw1_0_IRQn) +
+                               audio_dma_channel),
+        .intrPriority = CYHAL_ISR_PRIORITY_DEFAULT
+    };
+    if(CY_SYSINT_SUCCESS != Cy_SysInt_Init(&irq_cfg, &audio_capture_dma_irq_handler))
+    {
+        return audio_capture_error_generic;
+    }
+    NVIC_EnableIRQ(irq_cfg.intrSrc);
+
+    Cy_DMA_Channel_SetInterruptMask(audio_dma_base, audio_dma_channel, CY_DMA_INTR_MASK);
+    Cy_DMA_Enable(audio_dma_base);
+
+    return audio_capture_success;
+}
+
+/* Starts continuous capture to the sample ring */
+audio_capture_res_t audio_capture_start(void)
+{
+    if(NULL == audio_adc_chan_obj)
+    {
+        return audio_capture_error_not_started;
+    }
+
+    write_block = 0;
+    read_block = 0;
+    filled_blocks = 0;
+    held_blocks = 0;
+    overruns = 0;
+
+    /* Descriptors may be left repeating a block by the previous capture */
+    for(size_t block = 0; block < AUDIO_CAPTURE_BLOCKS; block++)
+    {
+        Cy_DMA_Descriptor_SetNextDescriptor(&audio_descriptors[block],
+                                            &audio_descriptors[(block + 1) % AUDIO_CAPTURE_BLOCKS]);
+    }
+
+    Cy_DMA_Channel_SetDescriptor(audio_dma_base, audio_dma_channel, &audio_descriptors[0]);
+    Cy_DMA_Channel_Enable(audio_dma_base, audio_dma_channel);
+
+    return audio_capture_success;
+}
+
+/* Waits for the next filled block. Block is owned by the application
+ * until audio_capture_release_block() is called */
+audio_capture_res_t audio_capture_get_block(int16_t** block)
+{
+    if(NULL == audio_adc_chan_obj)
+    {
+        return audio_capture_error_not_started;
+    }
+
+    xSemaphoreTake(audio_block_semaphore, portMAX_DELAY);
+
+    *block = audio_ring[read_block];
+#if MEASURE_LATENCY == 1
+    last_block = read_block;
+#endif
+    read_block = (read_block + 1) % AUDIO_CAPTURE_BLOCKS;
+    held_blocks++;
+
+    return audio_capture_success;
+}
+
+/* Gives the latest length samples held by the application.
+ * Samples are not copied, window may wrap around the end of the ring
+ * so it is returned as head segment followed by tail segment
+ * (tail is NULL when the whole window is contiguous) */
+audio_capture_res_t audio_capture_get_window(size_t length, const int16_t** head, size_t* head_length, const int16_t** tail)
+{
+    const int16_t* ring_samples = &audio_ring[0][0];
+    const size_t ring_length = AUDIO_CAPTURE_BLOCKS * AUDIO_CAPTURE_BLOCK_SIZE;
+
+    if(length > (held_blocks * AUDIO_CAPTURE_BLOCK_SIZE))
+    {
+        return audio_capture_error_not_enough_samples;
+    }
+
+    /* Window ends with the last block returned by audio_capture_get_block() */
+    size_t end = (read_block == 0) ? ring_length : (read_block * AUDIO_CAPTURE_BLOCK_SIZE);
+
+    if(end >= length)
+    {
+        *head = &ring_samples[end - length];
+        *head_length = length;
+        *tail = NULL;
+    }
+    else
+    {
+        *head = &ring_samples[ring_length - (length - end)];
+        *head_length = length - end;
+        *tail = ring_samples;
+    }
+
+    return audio_capture_success;
+}
+
+/* Returns the oldest block obtained with audio_capture_get_block() to DMA */
+void audio_capture_release_block(void)
+{
+    held_blocks--;
+
+    uint32_t critical_section = cyhal_system_critical_section_enter();
+    filled_blocks--;
+    /* DMA may repeat the block it fills because the ring was full */
+    audio_capture_link_next();
+    cyhal_system_critical_section_exit(critical_section);
+}
+
+/* Returns the oldest held blocks to DMA until only the ones that will be part
+ * of the next window of length samples are left. In steady state it is one block
+ * per window, after window got shorter it is all of the blocks it doesn't need */
+void audio_capture_release_blocks(size_t length)
+{
+    const size_t keep_blocks = (length / AUDIO_CAPTURE_BLOCK_SIZE) - 1;
+
+    while(held_blocks > keep_blocks)
+    {
+        audio_capture_release_block();
+    }
+}
+
+uint32_t audio_capture_get_overruns(void)
+{
+    return overruns;
+}
+
+#if MEASURE_LATENCY == 1
+/* Trace timestamp of the moment the last block returned by audio_capture_get_block()
+ * was filled, that is when its newest sample was captured */
+uint32_t audio_capture_get_block_timestamp(void)
+{
+    return block_timestamps[last_block];
+}
+#endif
+
+/* Called on completion of every descriptor. DMA already fills the next block,
+ * blocks it moved past since the previous IRQ are handed to the application */
+static void audio_capture_dma_irq_handler(void)
+{
+    BaseType_t yield_required = pdFALSE;
+
+    Cy_DMA_Channel_ClearInterrupt(audio_dma_base, audio_dma_channel);
+
+    uint32_t dma_block = Cy_DMA_Channel_GetCurrentDescriptor(audio_dma_base, audio_dma_channel) - audio_descriptors;
+#if MEASURE_LATENCY == 1
+    uint32_t timestamp = trace_get_timestamp();
+#endif
+
+    if(dma_block == write_block)
+    {
+        /* Ring was full, so DMA filled the same block again and its previous samples are dropped */
+        overruns++;
+#if MEASURE_LATENCY == 1
+        block_timestamps[write_block] = timestamp;
+#endif
+#if MEASURE_PERFORMANCE == 1
+        trace_event(TRACE_ID_AUDIO_OVERRUN, overruns);
+#endif
+    }
+
+    while(dma_block != write_block)
+    {
+#if MEASURE_LATENCY == 1
+        block_timestamps[write_block] = timestamp;
+#endif
+        filled_blocks++;
+        write_block = (write_block + 1) % AUDIO_CAPTURE_BLOCKS;
+        xSemaphoreGiveFromISR(audio_block_semaphore, &yield_required);
+#if MEASURE_PERFORMANCE == 1
+        trace_event(TRACE_ID_AUDIO_BLOCK, filled_blocks);
+#endif
+    }
+
+    audio_capture_link_next();
+
+    portYIELD_FROM_ISR(yield_required);
+}
+
+/* Chooses the block DMA fills after the current one. If the next block is
+ * still used by the application, DMA fills the current block again instead,
+ * so held blocks are never corrupted. Called from IRQ or critical section */
+static void audio_capture_link_next(void)
+{
+    uint32_t next_block = (write_block + 1) % AUDIO_CAPTURE_BLOCKS;
+    bool next_free = (filled_blocks + 2) <= AUDIO_CAPTURE_BLOCKS;
+
+    Cy_DMA_Descriptor_SetNextDescriptor(&audio_descriptors[write_block],
+                                        next_free ? &audio_descriptors[next_block] : &audio_descriptors[write_block]);
+}
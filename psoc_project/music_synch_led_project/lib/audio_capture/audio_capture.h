@@ -0,0 +1,26 @@
+#ifndef __AUDIO_CAPTURE_H__
+#define __AUDIO_CAPTURE_H__
+
+#include "app_config.h"
+#include "cyhal.h"
+
+typedef enum
+{
+    audio_capture_success,
+    audio_capture_error_generic,
+    audio_capture_error_not_started,
+    audio_capture_error_not_enough_samples
+} audio_capture_res_t;
+
+audio_capture_res_t audio_capture_init(cyhal_adc_channel_t* adc_chan_obj);
+audio_capture_res_t audio_capture_start(void);
+audio_capture_res_t audio_capture_get_block(int16_t** block);
+audio_capture_res_t audio_capture_get_window(size_t length, const int16_t** head, size_t* head_length, const int16_t** tail);
+void audio_capture_release_block(void);
+void audio_capture_release_blocks(size_t length);
+uint32_t audio_capture_get_overruns(void);
+#if MEASURE_LATENCY == 1
+uint32_t audio_capture_get_block_timestamp(void);
+#endif
+
+#endif /* __AUDIO_CAPTURE_H__ */
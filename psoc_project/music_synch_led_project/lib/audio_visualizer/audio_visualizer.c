@@ -1,42 +1,394 @@
 #include "audio_visualizer.h"
+#include "spectrum_bands.h"
+#include "led_matrix.h"
 #include "arm_math.h"
+#include <string.h>
 
-/* Buffer for LEDs. Used by visualization functions that
- * need to keep track of leds state */
-static led_color_t leds[WS2812_LEDS_COUNT];
+/* Magnitude that lights spectrum LED at full brightness.
+ * Taken from observations same as fft_to_fgb() thresholds */
+#define SPECTRUM_FULL_SCALE_MAGNITUDE   (0.00003f)
+
+/* If number of LEDs is even then we need to subtract 1
+ * to have midpoint with equal number of leds on both sides.
+ * In this case one LED is unused but this simplifies the
+ * rest of the code. */
+#if (WS2812_LEDS_COUNT % 2) == 0
+#define SNAKE_HALF_LEDS     ((WS2812_LEDS_COUNT - 1) / 2)
+#else
+#define SNAKE_HALF_LEDS     (WS2812_LEDS_COUNT / 2)
+#endif
+
+/* State of snake mode, snake flows from the first LED */
+typedef struct {
+    ws2812_ring_t ring;
+    uint8_t pixels[WS2812_RING_SIZE(WS2812_LEDS_COUNT)];
+} snake_state_t;
+
+/* State of bidirectional snake mode, snake flows from the midpoint
+ * to both ends, midpoint LED is the newest in both halves */
+typedef struct {
+    ws2812_ring_t left_ring;
+    ws2812_ring_t right_ring;
+    uint8_t left_pixels[WS2812_RING_SIZE(SNAKE_HALF_LEDS + 1)];
+    uint8_t right_pixels[WS2812_RING_SIZE(SNAKE_HALF_LEDS + 1)];
+} snake_bidirectional_state_t;
+
+/* Log spaced bands from SPECTRUM_MIN_FREQUENCY to SPECTRUM_MAX_FREQUENCY.
+ * Every mode that shows bands has its own one as the first member of its state */
+typedef struct {
+    size_t bands_count;
+    /* Bins of every band for every runtime FFT size, built once at init */
+    spectrum_bands_t bands[FFT_SIZES_COUNT];
+    /* Magnitude of a tone grows with FFT size, so band energies
+     * of every size are scaled to the level of FFT_SIZE */
+    float gains[FFT_SIZES_COUNT];
+#if BASS_ANALYSIS == 1
+    /* Bands below BASS_CROSSOVER_FREQUENCY are taken from the low rate
+     * bass spectrum, the rest of them from the full rate spectrum */
+    spectrum_bands_t bass_bands;
+    size_t bass_bands_count;
+    /* Bass FFT is shorter, so its magnitude of a tone is smaller by the size ratio */
+    float bass_gain;
+#endif
+} band_analyzer_t;
+
+/* State of spectrum analyzer mode */
+typedef struct {
+    band_analyzer_t analyzer;
+    /* Energy of every band */
+    float energies[SPECTRUM_BANDS_MAX];
+    /* Color of every LED at full brightness */
+    led_color_t colors[SPECTRUM_BANDS_MAX];
+} spectrum_state_t;
+
+/* State of matrix bars mode, every column is a bar of one band */
+typedef struct {
+    band_analyzer_t analyzer;
+    float energies[LED_MATRIX_COLUMNS];
+    /* Bars are green at the bottom and red at the top */
+    led_color_t row_colors[LED_MATRIX_ROWS];
+} matrix_bars_state_t;
+
+/* State of matrix spectrogram mode. Every frame bands are drawn as a new
+ * column on the right, low bands at the bottom, older columns move left */
+typedef struct {
+    band_analyzer_t analyzer;
+    float energies[LED_MATRIX_ROWS];
+    /* Ring of drawn columns, head is the oldest one */
+    led_color_t columns[LED_MATRIX_COLUMNS][LED_MATRIX_ROWS];
+    uint16_t head;
+} matrix_spectrogram_state_t;
+
+/* Pulse starts at BEAT_PULSE_MIN_LEVEL for the weakest beats and fades
+ * to BEAT_PULSE_END_LEVEL by the next expected beat */
+#define BEAT_PULSE_MIN_LEVEL        (0.4f)
+#define BEAT_PULSE_END_LEVEL        (0.05f)
+#define BEAT_PULSE_DEFAULT_BPM      (120.0f)
+#define BEAT_PULSE_COLORS_COUNT     (6)
+
+/* State of beat pulse mode, strip lights up from the midpoint on every
+ * beat with the next colour and fades out over one beat period */
+typedef struct {
+    /* Beat count of the last drawn beat, beat_count_valid is cleared on reset
+     * so switching to the mode doesn't draw beat that happened before */
+    uint32_t beat_count;
+    bool beat_count_valid;
+    float level;
+    /* Level multiplier per rendered frame */
+    float decay;
+    uint8_t color_index;
+} beat_pulse_state_t;
+
+/* Visualization mode. Hooks get the mode state, hooks that are not needed are NULL */
+typedef struct {
+    /* VISUALIZE_NEEDS_x flags of analysis products the mode consumes */
+    uint32_t needs;
+    void* state;
+    /* Called once from visualize_init() */
+    visualizer_res_t (*init)(void* state, float sample_rate);
+    /* Called on the first frame after switch to the mode */
+    void (*reset)(void* state);
+    /* Draws one frame from analysis products and sends it to the LEDs */
+    void (*render)(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                   const beat_info_t* beat);
+    /* Range of spectrum bins used by the mode, for VISUALIZE_NEEDS_SPECTRUM */
+    void (*get_bins)(const void* state, size_t fft_size, size_t* first_bin, size_t* bins_count);
+    /* Range of bass spectrum bins used by the mode, for VISUALIZE_NEEDS_BASS_SPECTRUM */
+    void (*get_bass_bins)(const void* state, size_t* first_bin, size_t* bins_count);
+} visualization_mode_desc_t;
+
+/* RGB modes take three parts of the spectrum either from FFT or from sliding DFT */
+#if RGB_MODES_ENGINE == ANALYSIS_ENGINE_SLIDING_DFT
+#define RGB_MODES_NEEDS     (VISUALIZE_NEEDS_TRACKED_BINS)
+#else
+#define RGB_MODES_NEEDS     (VISUALIZE_NEEDS_SPECTRUM)
+#endif
+
+#if BASS_ANALYSIS == 1
+#define SPECTRUM_MODE_NEEDS (VISUALIZE_NEEDS_SPECTRUM | VISUALIZE_NEEDS_BASS_SPECTRUM)
+#else
+#define SPECTRUM_MODE_NEEDS (VISUALIZE_NEEDS_SPECTRUM)
+#endif
+
+/* Every mode keeps its own state, nothing is shared between modes */
+static snake_state_t snake_state;
+static snake_bidirectional_state_t snake_bidirectional_state;
+static spectrum_state_t spectrum_state;
+static beat_pulse_state_t beat_pulse_state;
+static matrix_bars_state_t matrix_bars_state;
+static matrix_spectrogram_state_t matrix_spectrogram_state;
+
+static const led_color_t beat_pulse_colors[BEAT_PULSE_COLORS_COUNT] = {
+    { 255, 0, 0 },
+    { 255, 128, 0 },
+    { 0, 255, 0 },
+    { 0, 255, 255 },
+    { 0, 0, 255 },
+    { 255, 0, 255 }
+};
 
 /* Maps value from input range to output range
  * Note that this function will saturate input value that is outside on input range */
 static int32_t map(float val, float in_min, float in_max, float out_min, float out_max);
 static led_color_t fft_to_fgb(const float* fft_res, size_t fft_size);
+static void rgb_get_bins(const void* state, size_t fft_size, size_t* first_bin, size_t* bins_count);
 
-static void visualize_mode_map_rgb(const float* fft_res, size_t fft_size);
-static void visualize_mode_snake_flow(const float* fft_res, size_t fft_size);
-static void visualize_mode_snake_flow_bidirectional(const float* fft_res, size_t fft_size);
+static void map_rgb_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                           const beat_info_t* beat);
+static visualizer_res_t snake_init(void* state, float sample_rate);
+static void snake_reset(void* state);
+static void snake_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                         const beat_info_t* beat);
+static visualizer_res_t snake_bidirectional_init(void* state, float sample_rate);
+static void snake_bidirectional_reset(void* state);
+static void snake_bidirectional_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                                       const beat_info_t* beat);
+static visualizer_res_t band_analyzer_init(band_analyzer_t* analyzer, size_t bands_count, float sample_rate);
+static void band_analyzer_compute(const band_analyzer_t* analyzer, const float* fft_res, size_t fft_size,
+                                  const float* bass_res, float* energies);
+static void bands_get_bins(const void* state, size_t fft_size, size_t* first_bin, size_t* bins_count);
+static size_t spectrum_size_index(size_t fft_size);
+static visualizer_res_t spectrum_init(void* state, float sample_rate);
+static void spectrum_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                            const beat_info_t* beat);
+static void beat_pulse_reset(void* state);
+static void beat_pulse_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                              const beat_info_t* beat);
+static visualizer_res_t matrix_bars_init(void* state, float sample_rate);
+static void matrix_bars_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                               const beat_info_t* beat);
+static visualizer_res_t matrix_spectrogram_init(void* state, float sample_rate);
+static void matrix_spectrogram_reset(void* state);
+static void matrix_spectrogram_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                                      const beat_info_t* beat);
+static led_color_t heat_color(uint32_t level);
+#if BASS_ANALYSIS == 1
+static void bands_get_bass_bins(const void* state, size_t* first_bin, size_t* bins_count);
+static visualizer_res_t band_analyzer_init_bass(band_analyzer_t* analyzer, float sample_rate);
+#endif
+
+/* Registry of visualization modes, indexed by visualization_mode_t */
+static const visualization_mode_desc_t visualization_modes[VISUALIZATION_MODE_MAX] = {
+    [VISUALIZATION_MODE_MAP_RGB] = {
+        .needs = RGB_MODES_NEEDS,
+        .state = NULL,
+        .init = NULL,
+        .reset = NULL,
+        .render = map_rgb_render,
+        .get_bins = rgb_get_bins,
+        .get_bass_bins = NULL
+    },
+    [VISUALIZATION_MODE_SNAKE_FLOW] = {
+        .needs = RGB_MODES_NEEDS,
+        .state = &snake_state,
+        .init = snake_init,
+        .reset = snake_reset,
+        .render = snake_render,
+        .get_bins = rgb_get_bins,
+        .get_bass_bins = NULL
+    },
+    [VISUALIZATION_MODE_SNAKE_FLOW_BIDIRECTIONAL] = {
+        .needs = RGB_MODES_NEEDS,
+        .state = &snake_bidirectional_state,
+        .init = snake_bidirectional_init,
+        .reset = snake_bidirectional_reset,
+        .render = snake_bidirectional_render,
+        .get_bins = rgb_get_bins,
+        .get_bass_bins = NULL
+    },
+    [VISUALIZATION_MODE_SPECTRUM] = {
+        .needs = SPECTRUM_MODE_NEEDS,
+        .state = &spectrum_state,
+        .init = spectrum_init,
+        .reset = NULL,
+        .render = spectrum_render,
+        .get_bins = bands_get_bins,
+#if BASS_ANALYSIS == 1
+        .get_bass_bins = bands_get_bass_bins
+#else
+        .get_bass_bins = NULL
+#endif
+    },
+    [VISUALIZATION_MODE_BEAT_PULSE] = {
+        .needs = VISUALIZE_NEEDS_BEAT,
+        .state = &beat_pulse_state,
+        .init = NULL,
+        .reset = beat_pulse_reset,
+        .render = beat_pulse_render,
+        .get_bins = NULL,
+        .get_bass_bins = NULL
+    },
+    [VISUALIZATION_MODE_MATRIX_BARS] = {
+        .needs = SPECTRUM_MODE_NEEDS,
+        .state = &matrix_bars_state,
+        .init = matrix_bars_init,
+        .reset = NULL,
+        .render = matrix_bars_render,
+        .get_bins = bands_get_bins,
+#if BASS_ANALYSIS == 1
+        .get_bass_bins = bands_get_bass_bins
+#else
+        .get_bass_bins = NULL
+#endif
+    },
+    [VISUALIZATION_MODE_MATRIX_SPECTROGRAM] = {
+        .needs = SPECTRUM_MODE_NEEDS,
+        .state = &matrix_spectrogram_state,
+        .init = matrix_spectrogram_init,
+        .reset = matrix_spectrogram_reset,
+        .render = matrix_spectrogram_render,
+        .get_bins = bands_get_bins,
+#if BASS_ANALYSIS == 1
+        .get_bass_bins = bands_get_bass_bins
+#else
+        .get_bass_bins = NULL
+#endif
+    }
+};
+
+/* Mode of the last rendered frame, its state is reset when it changes */
+static visualization_mode_t visualize_active_mode = VISUALIZATION_MODE_MAX;
+
+/* Prepares every mode for all FFT sizes from FFT_MIN_SIZE to FFT_MAX_SIZE,
+ * so FFT size can be switched between frames without init */
+visualizer_res_t visualize_init(float sample_rate)
+{
+    /* Pixel to LED table of matrix modes */
+    led_matrix_init();
+
+    for(size_t mode = 0; mode < VISUALIZATION_MODE_MAX; mode++)
+    {
+        const visualization_mode_desc_t* desc = &visualization_modes[mode];
+
+        if((NULL != desc->init) && (visualizer_success != desc->init(desc->state, sample_rate)))
+        {
+            return visualizer_error_generic;
+        }
+    }
+
+    visualize_active_mode = VISUALIZATION_MODE_MAX;
+
+    return visualizer_success;
+}
+
+/* Gives VISUALIZE_NEEDS_x flags of the visualization mode. For tracked bins
+ * visualize_fft() expects power of the bins given by visualize_get_tracked_bins()
+ * instead of the full spectrum */
+uint32_t visualize_get_needs(visualization_mode_t visualization_mode)
+{
+    return visualization_modes[visualization_mode].needs;
+}
+
+/* Gives bins that represent three parts of the spectrum used by fft_to_fgb().
+ * Every part is split to SLIDING_DFT_BINS_PER_BAND equal pieces and center bin
+ * of each piece is taken, so thirds of the result are means of the same parts
+ * as in the full spectrum. DC bin is never taken */
+size_t visualize_get_tracked_bins(size_t fft_size, uint16_t* bins, size_t max_bins)
+{
+    size_t bins_count = 3 * SLIDING_DFT_BINS_PER_BAND;
+    size_t piece = fft_size / bins_count;
+
+    if((bins_count > max_bins) || (0 == piece))
+    {
+        return 0;
+    }
+
+    for(size_t i = 0; i < bins_count; i++)
+    {
+        bins[i] = (i * piece) + (piece / 2);
+        if(0 == bins[i])
+        {
+            bins[i] = 1;
+        }
+    }
+
+    return bins_count;
+}
+
+/* Gives range of power spectrum bins used by the visualization mode,
+ * other bins do not need to be computed. bins_count is 0 if spectrum is not used */
+void visualize_get_bins(visualization_mode_t visualization_mode, size_t fft_size, size_t* first_bin, size_t* bins_count)
+{
+    const visualization_mode_desc_t* desc = &visualization_modes[visualization_mode];
+
+    *first_bin = 0;
+    *bins_count = 0;
+
+    if(0 != (desc->needs & VISUALIZE_NEEDS_SPECTRUM))
+    {
+        desc->get_bins(desc->state, fft_size, first_bin, bins_count);
+    }
+}
+
+/* Gives range of bass spectrum bins used by the visualization mode,
+ * bins_count is 0 if bass spectrum is not used */
+void visualize_get_bass_bins(visualization_mode_t visualization_mode, size_t* first_bin, size_t* bins_count)
+{
+    const visualization_mode_desc_t* desc = &visualization_modes[visualization_mode];
+
+    *first_bin = 0;
+    *bins_count = 0;
+
+    if(0 != (desc->needs & VISUALIZE_NEEDS_BASS_SPECTRUM))
+    {
+        desc->get_bass_bins(desc->state, first_bin, bins_count);
+    }
+}
 
-/* TODO: Make visualization better, add more functions for different visualizations */
-void visualize_fft(const float* fft_res, size_t fft_size, visualization_mode_t visualization_mode)
+/* Draws one frame of the visualization mode. Every frame carries its own mode
+ * together with analysis products computed for it, so products always match the mode */
+void visualize_fft(const float* fft_res, size_t fft_size, const float* bass_res, const beat_info_t* beat,
+                   visualization_mode_t visualization_mode)
 {
-    switch (visualization_mode)
+    const visualization_mode_desc_t* desc = &visualization_modes[visualization_mode];
+
+    /* Mode starts from its initial state every time it is switched to */
+    if(visualization_mode != visualize_active_mode)
     {
-    case VISUALIZATION_MODE_MAP_RGB:
-        visualize_mode_map_rgb(fft_res, fft_size);
-        break;
-    case VISUALIZATION_MODE_SNAKE_FLOW:
-        visualize_mode_snake_flow(fft_res, fft_size);
-        break;
-    case VISUALIZATION_MODE_SNAKE_FLOW_BIDIRECTIONAL:
-        visualize_mode_snake_flow_bidirectional(fft_res, fft_size);
-        break;
-    default:
-        /* Endless loop to be safe */
-        while (1) {}
-        break;
+        if(NULL != desc->reset)
+        {
+            desc->reset(desc->state);
+        }
+        visualize_active_mode = visualization_mode;
     }
+
+    desc->render(desc->state, fft_res, fft_size, bass_res, beat);
 }
 
-static void visualize_mode_map_rgb(const float* fft_res, size_t fft_size)
+/* fft_to_fgb() uses three equal parts of the spectrum */
+static void rgb_get_bins(const void* state, size_t fft_size, size_t* first_bin, size_t* bins_count)
 {
+    (void)state;
+    *first_bin = 0;
+    *bins_count = (fft_size / 3) * 3;
+}
+
+static void map_rgb_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                           const beat_info_t* beat)
+{
+    (void)state;
+    (void)bass_res;
+    (void)beat;
     led_color_t led_color;
 
     /* Get LEDs colour value */
@@ -49,65 +401,515 @@ static void visualize_mode_map_rgb(const float* fft_res, size_t fft_size)
     ws2812_update();
 }
 
-static void visualize_mode_snake_flow(const float* fft_res, size_t fft_size)
+static visualizer_res_t snake_init(void* state, float sample_rate)
 {
+    (void)sample_rate;
+    snake_state_t* snake = state;
+
+    /* Start snake with turned off LEDs */
+    if(ws2812_success != ws2812_ring_init(&snake->ring, snake->pixels, WS2812_LEDS_COUNT, ws2812_ring_newest_first))
+    {
+        return visualizer_error_generic;
+    }
+
+    return visualizer_success;
+}
+
+static void snake_reset(void* state)
+{
+    snake_init(state, 0);
+}
+
+static void snake_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                         const beat_info_t* beat)
+{
+    (void)bass_res;
+    (void)beat;
+    snake_state_t* snake = state;
     led_color_t led_color;
 
     /* Get LEDs colour value */
     led_color = fft_to_fgb(fft_res, fft_size);
 
-    /* Shift LEDs */
-    for (size_t i = WS2812_LEDS_COUNT - 1; i > 0; i--)
-    {
-        leds[i] = leds[i - 1];
-        ws2812_set_led(i, leds[i].r, leds[i].g, leds[i].b);
-    }
+    /* Only the new LED is encoded, the rest of them are shifted by the ring */
+    ws2812_ring_push(&snake->ring, led_color.r, led_color.g, led_color.b);
 
-    /* Update RGB values of the first LED */
-    leds[0] = led_color;
-    ws2812_set_led(0, leds[0].r, leds[0].g, leds[0].b);
+    /* Set value for each LED */
+    ws2812_set_ring(&snake->ring, 0);
 
     /* Update LEDs */
     ws2812_update();
 }
 
-static void visualize_mode_snake_flow_bidirectional(const float* fft_res, size_t fft_size)
+static visualizer_res_t snake_bidirectional_init(void* state, float sample_rate)
 {
+    (void)sample_rate;
+    snake_bidirectional_state_t* snake = state;
+
+    /* Start snake with turned off LEDs */
+    if(ws2812_success != ws2812_ring_init(&snake->left_ring, snake->left_pixels, SNAKE_HALF_LEDS + 1, ws2812_ring_newest_last))
+    {
+        return visualizer_error_generic;
+    }
+
+    if(ws2812_success != ws2812_ring_init(&snake->right_ring, snake->right_pixels, SNAKE_HALF_LEDS + 1, ws2812_ring_newest_first))
+    {
+        return visualizer_error_generic;
+    }
+
+    return visualizer_success;
+}
+
+static void snake_bidirectional_reset(void* state)
+{
+    snake_bidirectional_init(state, 0);
+}
+
+static void snake_bidirectional_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                                       const beat_info_t* beat)
+{
+    (void)bass_res;
+    (void)beat;
+    snake_bidirectional_state_t* snake = state;
     led_color_t led_color;
 
     /* Get LEDs colour value */
     led_color = fft_to_fgb(fft_res, fft_size);
 
-    /* If number of LEDs is even then we need to subtract 1
-     * to have midpoint with equal number of leds on both sides.
-     * In this case one LED is unused but this simplifies the
-     * rest of the code. */
-#if (WS2812_LEDS_COUNT % 2) == 0
-    uint32_t half_leds = (WS2812_LEDS_COUNT - 1) / 2;
+    /* Left half is sent oldest first so it flows towards the first LED */
+    ws2812_ring_push(&snake->left_ring, led_color.r, led_color.g, led_color.b);
+    ws2812_ring_push(&snake->right_ring, led_color.r, led_color.g, led_color.b);
+
+    /* Both halves end with the midpoint LED */
+    ws2812_set_ring(&snake->left_ring, 0);
+    ws2812_set_ring(&snake->right_ring, SNAKE_HALF_LEDS);
+
+    /* Update LEDs */
+    ws2812_update();
+}
+
+/* Builds bands_count bands for every runtime FFT size.
+ * Should be called once at init, it is not fast */
+static visualizer_res_t band_analyzer_init(band_analyzer_t* analyzer, size_t bands_count, float sample_rate)
+{
+    analyzer->bands_count = bands_count;
+
+    /* Build bin to band tables */
+#if BASS_ANALYSIS == 1
+    if(visualizer_success != band_analyzer_init_bass(analyzer, sample_rate))
+    {
+        return visualizer_error_generic;
+    }
 #else
-    uint32_t half_leds = WS2812_LEDS_COUNT / 2;
+    for(size_t i = 0; i < FFT_SIZES_COUNT; i++)
+    {
+        spectrum_bands_res_t bands_res;
+        bands_res = spectrum_bands_init_log(&analyzer->bands[i], bands_count, SPECTRUM_MIN_FREQUENCY,
+                                            SPECTRUM_MAX_FREQUENCY, sample_rate, FFT_MIN_SIZE << i);
+        if(spectrum_bands_success != bands_res)
+        {
+            return visualizer_error_generic;
+        }
+    }
 #endif
 
-    /* Shift LEDs */
-    for (size_t i = half_leds; i >= 1; i--)
+    for(size_t i = 0; i < FFT_SIZES_COUNT; i++)
     {
-        leds[half_leds + i] = leds[half_leds + i - 1];
-        leds[half_leds - i] = leds[half_leds - i + 1];
+        analyzer->gains[i] = (float)FFT_SIZE / (FFT_MIN_SIZE << i);
     }
 
-    /* Update RGB values of the first LED */
-    leds[half_leds] = led_color;
+    return visualizer_success;
+}
 
-    /* Set value for each LED */
-    for (size_t i = 0; i < WS2812_LEDS_COUNT; i++)
+/* Gives energy of every band in the scale of FFT_SIZE */
+static void band_analyzer_compute(const band_analyzer_t* analyzer, const float* fft_res, size_t fft_size,
+                                  const float* bass_res, float* energies)
+{
+    const size_t size_index = spectrum_size_index(fft_size);
+    const float gain = analyzer->gains[size_index];
+
+#if BASS_ANALYSIS == 1
+    if(0 != analyzer->bass_bands_count)
     {
-        ws2812_set_led(i, leds[i].r, leds[i].g, leds[i].b);
+        spectrum_bands_compute(&analyzer->bass_bands, bass_res, energies);
+        for (size_t i = 0; i < analyzer->bass_bands_count; i++)
+        {
+            energies[i] *= analyzer->bass_gain;
+        }
+    }
+
+    if(analyzer->bass_bands_count < analyzer->bands_count)
+    {
+        spectrum_bands_compute(&analyzer->bands[size_index], fft_res, &energies[analyzer->bass_bands_count]);
+        for (size_t i = analyzer->bass_bands_count; i < analyzer->bands_count; i++)
+        {
+            energies[i] *= gain;
+        }
+    }
+#else
+    (void)bass_res;
+    spectrum_bands_compute(&analyzer->bands[size_index], fft_res, energies);
+    for (size_t i = 0; i < analyzer->bands_count; i++)
+    {
+        energies[i] *= gain;
+    }
+#endif
+}
+
+/* Bins of the modes that show bands, their state starts with band_analyzer_t */
+static void bands_get_bins(const void* state, size_t fft_size, size_t* first_bin, size_t* bins_count)
+{
+    const band_analyzer_t* analyzer = state;
+
+#if BASS_ANALYSIS == 1
+    if(analyzer->bass_bands_count == analyzer->bands_count)
+    {
+        /* All bands are in bass spectrum */
+        return;
+    }
+#endif
+    spectrum_bands_get_bins(&analyzer->bands[spectrum_size_index(fft_size)], first_bin, bins_count);
+}
+
+#if BASS_ANALYSIS == 1
+static void bands_get_bass_bins(const void* state, size_t* first_bin, size_t* bins_count)
+{
+    const band_analyzer_t* analyzer = state;
+
+    if(0 != analyzer->bass_bands_count)
+    {
+        spectrum_bands_get_bins(&analyzer->bass_bands, first_bin, bins_count);
+    }
+}
+#endif
+
+/* Band tables are indexed by FFT size, fft_size is the spectrum size,
+ * half of it. Sizes out of range take the nearest table */
+static size_t spectrum_size_index(size_t fft_size)
+{
+    size_t index = 0;
+
+    while((index < (FFT_SIZES_COUNT - 1)) && ((((size_t)FFT_MIN_SIZE / 2) << index) < fft_size))
+    {
+        index++;
+    }
+
+    return index;
+}
+
+static visualizer_res_t spectrum_init(void* state, float sample_rate)
+{
+    spectrum_state_t* spectrum = state;
+
+    if(visualizer_success != band_analyzer_init(&spectrum->analyzer, SPECTRUM_BANDS_COUNT, sample_rate))
+    {
+        return visualizer_error_generic;
+    }
+
+    /* Low bands are red, middle are green and high are blue */
+    for (size_t i = 0; i < SPECTRUM_BANDS_COUNT; i++)
+    {
+        int32_t position = map(i, 0, SPECTRUM_BANDS_COUNT - 1, 0, 510);
+        spectrum->colors[i].r = (position < 255) ? (255 - position) : 0;
+        spectrum->colors[i].g = (position < 255) ? position : (510 - position);
+        spectrum->colors[i].b = (position < 255) ? 0 : (position - 255);
+    }
+
+    return visualizer_success;
+}
+
+static void spectrum_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                            const beat_info_t* beat)
+{
+    (void)beat;
+    spectrum_state_t* spectrum = state;
+    const float level_scale = 256.0f / SPECTRUM_FULL_SCALE_MAGNITUDE;
+
+    /* Get energy of every band */
+    band_analyzer_compute(&spectrum->analyzer, fft_res, fft_size, bass_res, spectrum->energies);
+
+    /* Every LED is a bar that shows energy of its band with brightness.
+     * LEDs are set directly so colours are not kept twice in RAM */
+    for (size_t i = 0; i < SPECTRUM_BANDS_COUNT; i++)
+    {
+        uint32_t level = spectrum->energies[i] * level_scale;
+        if(level > 256)
+        {
+            level = 256;
+        }
+
+        ws2812_set_led(i, (spectrum->colors[i].r * level) >> 8, (spectrum->colors[i].g * level) >> 8,
+                       (spectrum->colors[i].b * level) >> 8);
     }
 
     /* Update LEDs */
     ws2812_update();
 }
 
+static void beat_pulse_reset(void* state)
+{
+    beat_pulse_state_t* pulse = state;
+
+    pulse->beat_count_valid = false;
+    pulse->level = 0;
+    pulse->decay = 0;
+}
+
+static void beat_pulse_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                              const beat_info_t* beat)
+{
+    (void)fft_res;
+    (void)fft_size;
+    (void)bass_res;
+    beat_pulse_state_t* pulse = state;
+
+    /* Render task draws only the latest analysis frame, so beat
+     * is taken from the counter rather than from the beat flag */
+    if(!pulse->beat_count_valid)
+    {
+        pulse->beat_count = beat->beat_count;
+        pulse->beat_count_valid = true;
+    }
+
+    if(beat->beat_count != pulse->beat_count)
+    {
+        pulse->beat_count = beat->beat_count;
+        pulse->level = BEAT_PULSE_MIN_LEVEL + ((1.0f - BEAT_PULSE_MIN_LEVEL) * beat->strength);
+        pulse->color_index = (pulse->color_index + 1) % BEAT_PULSE_COLORS_COUNT;
+
+        float tempo = (0 != beat->tempo_bpm) ? beat->tempo_bpm : BEAT_PULSE_DEFAULT_BPM;
+        pulse->decay = powf(BEAT_PULSE_END_LEVEL, tempo / (60.0f * FRAME_RATE_FPS));
+    }
+    else
+    {
+        pulse->level *= pulse->decay;
+    }
+
+    /* Pulse is lit around the midpoint, its width and brightness follow the level */
+    const led_color_t* color = &beat_pulse_colors[pulse->color_index];
+    uint32_t brightness = pulse->level * 256;
+    uint16_t radius = pulse->level * SNAKE_HALF_LEDS;
+
+    ws2812_set_all_leds(0, 0, 0);
+    if(0 != brightness)
+    {
+        ws2812_set_range(SNAKE_HALF_LEDS - radius, SNAKE_HALF_LEDS + radius, (color->r * brightness) >> 8,
+                         (color->g * brightness) >> 8, (color->b * brightness) >> 8);
+    }
+
+    /* Update LEDs */
+    ws2812_update();
+}
+
+static visualizer_res_t matrix_bars_init(void* state, float sample_rate)
+{
+    matrix_bars_state_t* bars = state;
+
+    if(visualizer_success != band_analyzer_init(&bars->analyzer, LED_MATRIX_COLUMNS, sample_rate))
+    {
+        return visualizer_error_generic;
+    }
+
+    /* Bottom rows are green, middle are yellow and top are red */
+    for(size_t y = 0; y < LED_MATRIX_ROWS; y++)
+    {
+        int32_t position = (LED_MATRIX_ROWS > 1) ? map(y, 0, LED_MATRIX_ROWS - 1, 0, 510) : 0;
+        bars->row_colors[y].r = (position < 255) ? position : 255;
+        bars->row_colors[y].g = (position < 255) ? 255 : (510 - position);
+        bars->row_colors[y].b = 0;
+    }
+
+    return visualizer_success;
+}
+
+static void matrix_bars_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                               const beat_info_t* beat)
+{
+    (void)beat;
+    matrix_bars_state_t* bars = state;
+    const float level_scale = (256.0f * LED_MATRIX_ROWS) / SPECTRUM_FULL_SCALE_MAGNITUDE;
+
+    band_analyzer_compute(&bars->analyzer, fft_res, fft_size, bass_res, bars->energies);
+
+    /* Bar height is in 1/256 of a row, the top pixel of the bar shows the fraction with brightness */
+    for(uint16_t x = 0; x < LED_MATRIX_COLUMNS; x++)
+    {
+        uint32_t level = bars->energies[x] * level_scale;
+        if(level > (256 * LED_MATRIX_ROWS))
+        {
+            level = 256 * LED_MATRIX_ROWS;
+        }
+
+        uint16_t full_rows = level >> 8;
+        for(uint16_t y = 0; y < full_rows; y++)
+        {
+            led_matrix_set_pixel(x, y, bars->row_colors[y].r, bars->row_colors[y].g, bars->row_colors[y].b);
+        }
+
+        if(full_rows < LED_MATRIX_ROWS)
+        {
+            uint32_t fraction = level & 0xFF;
+            const led_color_t* color = &bars->row_colors[full_rows];
+
+            led_matrix_set_pixel(x, full_rows, (color->r * fraction) >> 8, (color->g * fraction) >> 8,
+                                 (color->b * fraction) >> 8);
+        }
+
+        if((full_rows + 1) < LED_MATRIX_ROWS)
+        {
+            led_matrix_fill_rect(x, full_rows + 1, 1, LED_MATRIX_ROWS, 0, 0, 0);
+        }
+    }
+
+    /* Update LEDs */
+    ws2812_update();
+}
+
+static visualizer_res_t matrix_spectrogram_init(void* state, float sample_rate)
+{
+    matrix_spectrogram_state_t* spectrogram = state;
+
+    if(visualizer_success != band_analyzer_init(&spectrogram->analyzer, LED_MATRIX_ROWS, sample_rate))
+    {
+        return visualizer_error_generic;
+    }
+
+    matrix_spectrogram_reset(state);
+
+    return visualizer_success;
+}
+
+/* Spectrogram starts empty */
+static void matrix_spectrogram_reset(void* state)
+{
+    matrix_spectrogram_state_t* spectrogram = state;
+
+    memset(spectrogram->columns, 0, sizeof(spectrogram->columns));
+    spectrogram->head = 0;
+}
+
+static void matrix_spectrogram_render(void* state, const float* fft_res, size_t fft_size, const float* bass_res,
+                                      const beat_info_t* beat)
+{
+    (void)beat;
+    matrix_spectrogram_state_t* spectrogram = state;
+    const float level_scale = 256.0f / SPECTRUM_FULL_SCALE_MAGNITUDE;
+
+    band_analyzer_compute(&spectrogram->analyzer, fft_res, fft_size, bass_res, spectrogram->energies);
+
+    /* The oldest column is replaced by the new one */
+    led_color_t* column = spectrogram->columns[spectrogram->head];
+    for(size_t y = 0; y < LED_MATRIX_ROWS; y++)
+    {
+        uint32_t level = spectrogram->energies[y] * level_scale;
+        column[y] = heat_color(level);
+    }
+    spectrogram->head = (spectrogram->head + 1) % LED_MATRIX_COLUMNS;
+
+    /* Columns are drawn from the oldest on the left to the newest on the right */
+    for(uint16_t x = 0; x < LED_MATRIX_COLUMNS; x++)
+    {
+        led_matrix_set_column(x, spectrogram->columns[(spectrogram->head + x) % LED_MATRIX_COLUMNS]);
+    }
+
+    /* Update LEDs */
+    ws2812_update();
+}
+
+/* Colour of the level from 0 to 256: black, blue, red, yellow */
+static led_color_t heat_color(uint32_t level)
+{
+    led_color_t color = { 0, 0, 0 };
+    uint32_t position = (level < 256) ? (level * 3) : 765;
+
+    if(position < 255)
+    {
+        color.b = position;
+    }
+    else if(position < 510)
+    {
+        color.r = position - 255;
+        color.b = 510 - position;
+    }
+    else
+    {
+        color.r = 255;
+        color.g = position - 510;
+    }
+
+    return color;
+}
+
+#if BASS_ANALYSIS == 1
+/* Splits log spaced bands at BASS_CROSSOVER_FREQUENCY, low bands are built
+ * over decimated bass spectrum and high ones over full rate spectrum of every FFT size.
+ * Bass bands are at least one bin wide, so there are only as many of them as fit below
+ * the crossover bin and high bands start at the top edge of the last bass band */
+static visualizer_res_t band_analyzer_init_bass(band_analyzer_t* analyzer, float sample_rate)
+{
+    static float edges[SPECTRUM_BANDS_MAX + 1];
+    spectrum_bands_res_t bands_res;
+    const size_t bands_count = analyzer->bands_count;
+    const float bass_sample_rate = sample_rate / BASS_DECIMATION_FACTOR;
+    const float bass_bin_width = bass_sample_rate / BASS_FFT_SIZE;
+    const int32_t crossover_bin = lroundf(BASS_CROSSOVER_FREQUENCY / bass_bin_width);
+    float ratio = powf(SPECTRUM_MAX_FREQUENCY / SPECTRUM_MIN_FREQUENCY, 1.0f / bands_count);
+    float frequency = SPECTRUM_MIN_FREQUENCY;
+    int32_t edge_bin = 0;
+
+    for(size_t b = 0; b <= bands_count; b++)
+    {
+        edges[b] = frequency;
+        frequency *= ratio;
+    }
+
+    /* Same rounding and widening as spectrum_bands does, bin 0 is DC */
+    analyzer->bass_bands_count = 0;
+    for(size_t b = 0; b <= bands_count; b++)
+    {
+        int32_t bin = lroundf(edges[b] / bass_bin_width);
+        if(bin <= edge_bin)
+        {
+            bin = edge_bin + 1;
+        }
+        if(bin > crossover_bin)
+        {
+            break;
+        }
+        edge_bin = bin;
+        analyzer->bass_bands_count = b;
+    }
+
+    if(0 != analyzer->bass_bands_count)
+    {
+        /* Crossover is moved to the actual top edge of bass bands */
+        edges[analyzer->bass_bands_count] = edge_bin * bass_bin_width;
+
+        bands_res = spectrum_bands_init_edges(&analyzer->bass_bands, analyzer->bass_bands_count, edges,
+                                              bass_sample_rate, BASS_FFT_SIZE);
+        if((spectrum_bands_success != bands_res) ||
+           (edge_bin != analyzer->bass_bands.edges[analyzer->bass_bands_count]))
+        {
+            return visualizer_error_generic;
+        }
+    }
+
+    for(size_t i = 0; (i < FFT_SIZES_COUNT) && (analyzer->bass_bands_count < bands_count); i++)
+    {
+        bands_res = spectrum_bands_init_edges(&analyzer->bands[i], bands_count - analyzer->bass_bands_count,
+                                              &edges[analyzer->bass_bands_count], sample_rate, FFT_MIN_SIZE << i);
+        if(spectrum_bands_success != bands_res)
+        {
+            return visualizer_error_generic;
+        }
+    }
+
+    analyzer->bass_gain = (float)FFT_SIZE / BASS_FFT_SIZE;
+
+    return visualizer_success;
+}
+#endif
+
 static int32_t map(float val, float in_min, float in_max, float out_min, float out_max)
 {
     if(val > in_max)
@@ -127,10 +929,19 @@ static int32_t map(float val, float in_min, float in_max, float out_min, float o
 static led_color_t fft_to_fgb(const float* fft_res, size_t fft_size)
 {
     /* These values are taken from my observations
-     * so i wouldn't rely on them very much */
-    const float low_frequency_threshold = 0.00007;
-    const float medium_frequency_threshold = 0.00002;
-    const float high_frequency_threshold = 0.00002;
+     * so i wouldn't rely on them very much.
+     * They were observed with mean magnitude and are scaled to RMS of every third,
+     * which is about 1.3 times larger for peaky low third and 1.13 for noise-like ones */
+    const float low_frequency_threshold = 0.00009;
+    const float medium_frequency_threshold = 0.000023;
+    const float high_frequency_threshold = 0.000023;
+#if RGB_MODES_ENGINE == ANALYSIS_ENGINE_FFT
+    /* Thresholds are observed with FFT_SIZE, spectrum of other sizes is scaled to it */
+    const float gain = (float)FFT_SIZE_HALF / fft_size;
+#else
+    /* Sliding DFT always works in the scale of FFT_SIZE */
+    const float gain = 1.0f;
+#endif
 
     float low_mean;
     float medium_mean;
@@ -138,11 +949,16 @@ static led_color_t fft_to_fgb(const float* fft_res, size_t fft_size)
 
     led_color_t res;
 
-    /* Find mean value for low, medium and hight frequencies */
+    /* Find mean power for low, medium and hight frequencies */
     arm_mean_f32(&fft_res[fft_size / 3 * 0], fft_size / 3, &low_mean);
     arm_mean_f32(&fft_res[fft_size / 3 * 1], fft_size / 3, &medium_mean);
     arm_mean_f32(&fft_res[fft_size / 3 * 2], fft_size / 3, &high_mean);
 
+    /* Convert power to magnitude, it is RMS of every third */
+    low_mean = sqrtf(low_mean) * gain;
+    medium_mean = sqrtf(medium_mean) * gain;
+    high_mean = sqrtf(high_mean) * gain;
+
     /* Map mean value to LED color */
     res.r = map(low_mean, 0, low_frequency_threshold, 0, 255);
     res.g = map(medium_mean, 0, medium_frequency_threshold, 0, 255);
@@ -2,14 +2,45 @@
 #define __AUDIO_VISUALIZER_H__
 
 #include "ws2812.h"
+#include "beat_detector.h"
+
+typedef enum
+{
+    visualizer_success,
+    visualizer_error_generic
+} visualizer_res_t;
 
 typedef enum {
     VISUALIZATION_MODE_MAP_RGB,
     VISUALIZATION_MODE_SNAKE_FLOW,
     VISUALIZATION_MODE_SNAKE_FLOW_BIDIRECTIONAL,
+    VISUALIZATION_MODE_SPECTRUM,
+    VISUALIZATION_MODE_BEAT_PULSE,
+    VISUALIZATION_MODE_MATRIX_BARS,
+    VISUALIZATION_MODE_MATRIX_SPECTROGRAM,
     VISUALIZATION_MODE_MAX
 } visualization_mode_t;
 
-void visualize_fft(const float* fft_res, size_t fft_size, visualization_mode_t visualization_mode);
+/* Analysis products a visualization mode consumes, analysis
+ * pipeline computes only the ones needed by the current mode */
+typedef enum {
+    /* Power spectrum of bins given by visualize_get_bins() */
+    VISUALIZE_NEEDS_SPECTRUM = 1 << 0,
+    /* Sliding DFT power of bins given by visualize_get_tracked_bins() */
+    VISUALIZE_NEEDS_TRACKED_BINS = 1 << 1,
+    /* Power spectrum of decimated audio, bins given by visualize_get_bass_bins() */
+    VISUALIZE_NEEDS_BASS_SPECTRUM = 1 << 2,
+    /* Beat state from spectral flux of the full rate spectrum,
+     * can't be combined with VISUALIZE_NEEDS_TRACKED_BINS */
+    VISUALIZE_NEEDS_BEAT = 1 << 3
+} visualize_needs_t;
+
+visualizer_res_t visualize_init(float sample_rate);
+uint32_t visualize_get_needs(visualization_mode_t visualization_mode);
+size_t visualize_get_tracked_bins(size_t fft_size, uint16_t* bins, size_t max_bins);
+void visualize_get_bins(visualization_mode_t visualization_mode, size_t fft_size, size_t* first_bin, size_t* bins_count);
+void visualize_get_bass_bins(visualization_mode_t visualization_mode, size_t* first_bin, size_t* bins_count);
+void visualize_fft(const float* fft_res, size_t fft_size, const float* bass_res, const beat_info_t* beat,
+                   visualization_mode_t visualization_mode);
 
 #endif /* __AUDIO_VISUALIZER_H__ */
@@ -0,0 +1,229 @@
+#include "beat_detector.h"
+
+/* Power of a barely audible bin. Bins are compared as log(1 + power / reference),
+ * so quieter bins add almost nothing to the flux and loud ones are compressed */
+#define BEAT_DETECTOR_REFERENCE_POWER   (1e-12f)
+
+/* Fall of the peak hold of every bin in nepers per second, about 37 dB/s.
+ * Level of a bin flutters from window to window with the phase of steady tones,
+ * flutter stays under the hold and only onsets rise above it */
+#define BEAT_DETECTOR_RELEASE           (8.6f)
+
+/* Flux floor of the threshold, keeps noise in silence from triggering beats */
+#define BEAT_DETECTOR_MIN_FLUX          (0.1f)
+
+/* Part of the history that must be filled before beats are reported */
+#define BEAT_DETECTOR_MIN_HISTORY       (BEAT_HISTORY_SIZE / 4)
+
+/* Beat period that differs from the estimate by less than this ratio
+ * refines it, after BEAT_DETECTOR_RELOCK_BEATS others in a row it is replaced */
+#define BEAT_DETECTOR_TEMPO_TOLERANCE   (0.15f)
+#define BEAT_DETECTOR_TEMPO_SMOOTHING   (0.2f)
+#define BEAT_DETECTOR_RELOCK_BEATS      (4)
+
+static void beat_detector_update_tempo(beat_detector_t* detector, uint32_t interval);
+static void beat_detector_push_history(beat_detector_t* detector, float flux);
+
+/* Takes FFT bins from BEAT_MIN_FREQUENCY to BEAT_MAX_FREQUENCY.
+ * frame_rate is the number of process calls per second */
+beat_detector_res_t beat_detector_init(beat_detector_t* detector, size_t fft_size, float sample_rate, float frame_rate)
+{
+    detector->frame_rate = frame_rate;
+    detector->release = BEAT_DETECTOR_RELEASE / frame_rate;
+    detector->min_interval = (BEAT_MIN_INTERVAL_MS * frame_rate) / 1000;
+    detector->min_period = (60.0f * frame_rate) / BEAT_MAX_BPM;
+    detector->max_period = (60.0f * frame_rate) / BEAT_MIN_BPM;
+    detector->beat_count = 0;
+
+    return beat_detector_set_fft_size(detector, fft_size, sample_rate);
+}
+
+/* Moves the detector to bins of another FFT size. History of the previous
+ * size doesn't apply to the new bins so detection starts over, beat count
+ * is kept so consumers don't see a beat that didn't happen */
+beat_detector_res_t beat_detector_set_fft_size(beat_detector_t* detector, size_t fft_size, float sample_rate)
+{
+    const float bin_width = sample_rate / fft_size;
+    size_t first_bin = ceilf(BEAT_MIN_FREQUENCY / bin_width);
+    size_t last_bin = BEAT_MAX_FREQUENCY / bin_width;
+
+    /* DC bin carries no onsets */
+    if(0 == first_bin)
+    {
+        first_bin = 1;
+    }
+
+    if((last_bin < first_bin) || (last_bin >= (fft_size / 2)) ||
+       (((last_bin - first_bin) + 1) > BEAT_DETECTOR_MAX_BINS))
+    {
+        return beat_detector_error_invalid_bins;
+    }
+
+    detector->first_bin = first_bin;
+    detector->bins_count = (last_bin - first_bin) + 1;
+
+    beat_detector_reset(detector);
+
+    return beat_detector_success;
+}
+
+/* Starts over without history, the first frame after reset only primes the peak hold */
+void beat_detector_reset(beat_detector_t* detector)
+{
+    detector->primed = false;
+    detector->history_index = 0;
+    detector->history_filled = 0;
+    detector->history_sum = 0;
+    detector->history_sum_squares = 0;
+    detector->period = 0;
+    detector->period_outliers = 0;
+    detector->beat_seen = false;
+    detector->frames_since_beat = 0;
+    detector->strength = 0;
+}
+
+/* Gives range of power spectrum bins used by the detector */
+void beat_detector_get_bins(const beat_detector_t* detector, size_t* first_bin, size_t* bins_count)
+{
+    *first_bin = detector->first_bin;
+    *bins_count = detector->bins_count;
+}
+
+/* Updates the detector with power spectrum of the next analysis frame, power is
+ * indexed by FFT bin. Spectral flux is the mean rise of log power over the peak hold
+ * of previous frames, beat is reported as soon as it crosses the threshold, without
+ * waiting for its peak */
+void beat_detector_process(beat_detector_t* detector, const float* power, beat_info_t* info)
+{
+    const float* bins = &power[detector->first_bin];
+    const float gain = 1.0f / BEAT_DETECTOR_REFERENCE_POWER;
+    float flux = 0;
+
+    /* Only rising bins count, so decays and sustained notes give no flux */
+    for(size_t i = 0; i < detector->bins_count; i++)
+    {
+        float level = logf(1.0f + (bins[i] * gain));
+        float hold = detector->hold[i] - detector->release;
+        if(level > hold)
+        {
+            flux += level - hold;
+            hold = level;
+        }
+        detector->hold[i] = hold;
+    }
+    flux /= detector->bins_count;
+
+    info->beat = false;
+
+    if(!detector->primed)
+    {
+        /* Hold was not valid, neither is the flux */
+        detector->primed = true;
+    }
+    else
+    {
+        if(detector->frames_since_beat < UINT32_MAX)
+        {
+            detector->frames_since_beat++;
+        }
+
+        if(detector->history_filled >= BEAT_DETECTOR_MIN_HISTORY)
+        {
+            float mean = detector->history_sum / detector->history_filled;
+            float variance = (detector->history_sum_squares / detector->history_filled) - (mean * mean);
+            float threshold = mean + (BEAT_THRESHOLD_SIGMA * sqrtf((variance > 0) ? variance : 0)) +
+                              BEAT_DETECTOR_MIN_FLUX;
+
+            if((flux > threshold) && (detector->frames_since_beat >= detector->min_interval))
+            {
+                if(detector->beat_seen)
+                {
+                    beat_detector_update_tempo(detector, detector->frames_since_beat);
+                }
+
+                detector->strength = (flux - threshold) / threshold;
+                if(detector->strength > 1.0f)
+                {
+                    detector->strength = 1.0f;
+                }
+                detector->frames_since_beat = 0;
+                detector->beat_seen = true;
+                detector->beat_count++;
+                info->beat = true;
+            }
+        }
+
+        beat_detector_push_history(detector, flux);
+    }
+
+    info->beat_count = detector->beat_count;
+    info->strength = detector->strength;
+    info->frames_since_beat = detector->frames_since_beat;
+    info->tempo_bpm = (0 != detector->period) ? ((60.0f * detector->frame_rate) / detector->period) : 0;
+}
+
+/* Intervals are folded by octaves into the tempo range, as beats may be
+ * detected only on every other beat or on off-beats too */
+static void beat_detector_update_tempo(beat_detector_t* detector, uint32_t interval)
+{
+    float period = interval;
+
+    /* Pause in the music, nothing to measure */
+    if(period > (2 * detector->max_period))
+    {
+        return;
+    }
+
+    while(period < detector->min_period)
+    {
+        period *= 2;
+    }
+    while(period > detector->max_period)
+    {
+        period /= 2;
+    }
+
+    if((0 != detector->period) &&
+       (fabsf(period - detector->period) < (detector->period * BEAT_DETECTOR_TEMPO_TOLERANCE)))
+    {
+        detector->period += BEAT_DETECTOR_TEMPO_SMOOTHING * (period - detector->period);
+        detector->period_outliers = 0;
+    }
+    else if((0 == detector->period) || (++detector->period_outliers >= BEAT_DETECTOR_RELOCK_BEATS))
+    {
+        detector->period = period;
+        detector->period_outliers = 0;
+    }
+}
+
+/* Sums are updated with the entering and leaving flux, and computed again
+ * from the history once per its length so rounding errors do not accumulate */
+static void beat_detector_push_history(beat_detector_t* detector, float flux)
+{
+    if(detector->history_filled == BEAT_HISTORY_SIZE)
+    {
+        float oldest = detector->history[detector->history_index];
+        detector->history_sum -= oldest;
+        detector->history_sum_squares -= oldest * oldest;
+    }
+    else
+    {
+        detector->history_filled++;
+    }
+
+    detector->history[detector->history_index] = flux;
+    detector->history_sum += flux;
+    detector->history_sum_squares += flux * flux;
+    detector->history_index = (detector->history_index + 1) % BEAT_HISTORY_SIZE;
+
+    if(0 == detector->history_index)
+    {
+        detector->history_sum = 0;
+        detector->history_sum_squares = 0;
+        for(size_t i = 0; i < BEAT_HISTORY_SIZE; i++)
+        {
+            detector->history_sum += detector->history[i];
+            detector->history_sum_squares += detector->history[i] * detector->history[i];
+        }
+    }
+}
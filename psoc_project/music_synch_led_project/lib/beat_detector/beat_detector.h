@@ -0,0 +1,66 @@
+#ifndef __BEAT_DETECTOR_H__
+#define __BEAT_DETECTOR_H__
+
+#include <stdbool.h>
+#include "arm_math.h"
+#include "app_config.h"
+
+/* Maximum number of analysed bins, FFT_MAX_SIZE bins up to BEAT_MAX_FREQUENCY */
+#define BEAT_DETECTOR_MAX_BINS  (((BEAT_MAX_FREQUENCY * FFT_MAX_SIZE) / AUDIO_SAMPLING_RATE) + 1)
+
+typedef enum
+{
+    beat_detector_success,
+    beat_detector_error_invalid_bins
+} beat_detector_res_t;
+
+/* Beat state after one analysis frame */
+typedef struct {
+    /* Set on the analysis frame in which onset was detected */
+    bool beat;
+    /* Number of beats since init. Consumers that skip analysis frames
+     * compare it with the last value they have seen so no beat is missed */
+    uint32_t beat_count;
+    /* How far flux of the last beat was over the threshold, 0 - 1 */
+    float strength;
+    /* Analysis frames since the last beat */
+    uint32_t frames_since_beat;
+    /* Tempo estimate in beats per minute, 0 until it is known */
+    float tempo_bpm;
+} beat_info_t;
+
+typedef struct {
+    size_t first_bin;
+    size_t bins_count;
+    /* Decaying peak hold of log compressed power, the only kept spectrum */
+    float hold[BEAT_DETECTOR_MAX_BINS];
+    float release;
+    bool primed;
+    /* Flux of the last BEAT_HISTORY_SIZE frames, oldest one is at history_index */
+    float history[BEAT_HISTORY_SIZE];
+    size_t history_index;
+    size_t history_filled;
+    float history_sum;
+    float history_sum_squares;
+    /* Limits in analysis frames */
+    uint32_t min_interval;
+    float min_period;
+    float max_period;
+    float frame_rate;
+    /* Smoothed beat period in analysis frames, 0 until it is known */
+    float period;
+    uint32_t period_outliers;
+    /* Beat intervals are measured once a beat was seen after reset */
+    bool beat_seen;
+    uint32_t frames_since_beat;
+    uint32_t beat_count;
+    float strength;
+} beat_detector_t;
+
+beat_detector_res_t beat_detector_init(beat_detector_t* detector, size_t fft_size, float sample_rate, float frame_rate);
+beat_detector_res_t beat_detector_set_fft_size(beat_detector_t* detector, size_t fft_size, float sample_rate);
+void beat_detector_reset(beat_detector_t* detector);
+void beat_detector_get_bins(const beat_detector_t* detector, size_t* first_bin, size_t* bins_count);
+void beat_detector_process(beat_detector_t* detector, const float* power, beat_info_t* info);
+
+#endif /* __BEAT_DETECTOR_H__ */
@@ -0,0 +1,100 @@
+#include "decimator.h"
+
+#if (AUDIO_CAPTURE_BLOCK_SIZE % BASS_DECIMATION_FACTOR) != 0
+#error "AUDIO_CAPTURE_BLOCK_SIZE must be a multiple of BASS_DECIMATION_FACTOR"
+#endif
+
+#if (BASS_FIR_TAPS % BASS_DECIMATION_FACTOR) != 0
+#error "BASS_FIR_TAPS must be a multiple of BASS_DECIMATION_FACTOR"
+#endif
+
+/* Designs low-pass filter with cutoff at the decimated Nyquist frequency
+ * (windowed sinc, Hamming window, unity gain at DC), so decimated samples
+ * stay in ADC units. Should be called once at init, it is not fast */
+decimator_res_t decimator_init(decimator_t* decimator)
+{
+    arm_status arm_res;
+    const float center = (BASS_FIR_TAPS - 1) / 2.0f;
+    float sum = 0;
+
+    for(size_t n = 0; n < BASS_FIR_TAPS; n++)
+    {
+        float x = (n - center) / BASS_DECIMATION_FACTOR;
+        float sinc = (0.0f == x) ? 1.0f : (sinf(PI * x) / (PI * x));
+        float window = 0.54f - (0.46f * cosf((2 * PI * n) / (BASS_FIR_TAPS - 1)));
+
+        decimator->coefficients[n] = sinc * window;
+        sum += decimator->coefficients[n];
+    }
+
+    for(size_t n = 0; n < BASS_FIR_TAPS; n++)
+    {
+        decimator->coefficients[n] /= sum;
+    }
+
+    /* CMSIS decimator is polyphase, it computes only samples that are kept */
+    arm_res = arm_fir_decimate_init_f32(&decimator->fir, BASS_FIR_TAPS, BASS_DECIMATION_FACTOR,
+                                        decimator->coefficients, decimator->state, AUDIO_CAPTURE_BLOCK_SIZE);
+    if(ARM_MATH_SUCCESS != arm_res)
+    {
+        return decimator_error_generic;
+    }
+
+    decimator_reset(decimator);
+
+    return decimator_success;
+}
+
+/* Starts over from silence, window is valid again after BASS_FFT_SIZE low rate samples */
+void decimator_reset(decimator_t* decimator)
+{
+    arm_fill_f32(0, decimator->state, BASS_FIR_TAPS + AUDIO_CAPTURE_BLOCK_SIZE - 1);
+    decimator->write_index = 0;
+    decimator->filled = 0;
+}
+
+/* Filters one capture block and appends DECIMATOR_OUTPUT_SIZE
+ * low rate samples to the window */
+void decimator_process(decimator_t* decimator, const int16_t* block)
+{
+    /* Filter is linear, so samples are taken as Q15 and
+     * conversion back to Q15 gives them in ADC units again */
+    arm_q15_to_float(block, decimator->input, AUDIO_CAPTURE_BLOCK_SIZE);
+    arm_fir_decimate_f32(&decimator->fir, decimator->input, decimator->output, AUDIO_CAPTURE_BLOCK_SIZE);
+
+    for(size_t i = 0; i < DECIMATOR_OUTPUT_SIZE; )
+    {
+        size_t length = BASS_FFT_SIZE - decimator->write_index;
+        if(length > (DECIMATOR_OUTPUT_SIZE - i))
+        {
+            length = DECIMATOR_OUTPUT_SIZE - i;
+        }
+
+        arm_float_to_q15(&decimator->output[i], &decimator->window[decimator->write_index], length);
+
+        i += length;
+        decimator->write_index = (decimator->write_index + length) % BASS_FFT_SIZE;
+    }
+
+    if(decimator->filled < BASS_FFT_SIZE)
+    {
+        decimator->filled += DECIMATOR_OUTPUT_SIZE;
+    }
+}
+
+/* Gives the latest BASS_FFT_SIZE low rate samples as head segment
+ * followed by tail segment, same as audio_capture_get_window() */
+decimator_res_t decimator_get_window(const decimator_t* decimator, const int16_t** head, size_t* head_length,
+                                     const int16_t** tail)
+{
+    if(decimator->filled < BASS_FFT_SIZE)
+    {
+        return decimator_error_not_enough_samples;
+    }
+
+    *head = &decimator->window[decimator->write_index];
+    *head_length = BASS_FFT_SIZE - decimator->write_index;
+    *tail = decimator->window;
+
+    return decimator_success;
+}
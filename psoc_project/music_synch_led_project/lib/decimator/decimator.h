@@ -0,0 +1,35 @@
+#ifndef __DECIMATOR_H__
+#define __DECIMATOR_H__
+
+#include "arm_math.h"
+#include "app_config.h"
+
+/* Number of low rate samples produced from one capture block */
+#define DECIMATOR_OUTPUT_SIZE   (AUDIO_CAPTURE_BLOCK_SIZE / BASS_DECIMATION_FACTOR)
+
+typedef enum
+{
+    decimator_success,
+    decimator_error_generic,
+    decimator_error_not_enough_samples
+} decimator_res_t;
+
+typedef struct {
+    arm_fir_decimate_instance_f32 fir;
+    float coefficients[BASS_FIR_TAPS];
+    float state[BASS_FIR_TAPS + AUDIO_CAPTURE_BLOCK_SIZE - 1];
+    float input[AUDIO_CAPTURE_BLOCK_SIZE];
+    float output[DECIMATOR_OUTPUT_SIZE];
+    /* Latest BASS_FFT_SIZE low rate samples, oldest one is at write_index */
+    int16_t window[BASS_FFT_SIZE];
+    size_t write_index;
+    size_t filled;
+} decimator_t;
+
+decimator_res_t decimator_init(decimator_t* decimator);
+void decimator_reset(decimator_t* decimator);
+void decimator_process(decimator_t* decimator, const int16_t* block);
+decimator_res_t decimator_get_window(const decimator_t* decimator, const int16_t** head, size_t* head_length,
+                                     const int16_t** tail);
+
+#endif /* __DECIMATOR_H__ */
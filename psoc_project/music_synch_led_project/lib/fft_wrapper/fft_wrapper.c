@@ -1,11 +1,148 @@
 #include "fft_wrapper.h"
 #include <stdio.h>
+#include <string.h>
 
 /* 0 -> FFT, 1 -> IFFT */
 #define IFFT_FLAG               (0)
 
+/* 0 -> disable bit reversal, 1 -> enable bit reversal */
+#define BIT_REVERSE_FLAG        (1)
+
+/* Shifts that scale ADC samples to the full range of fixed-point input */
+#define Q15_INPUT_SHIFT         (16 - AUDIO_SAMPLE_BITS)
+#define Q31_INPUT_SHIFT         (32 - AUDIO_SAMPLE_BITS)
+
+/* Magnitude of the float engine for samples taken as Q31 */
+#define FLOAT_ENGINE_SCALE      (1.0f / 2147483648.0f)
+
+/* Windowed sample is the product of the sample and Q15 window
+ * coefficient, these shifts give it in the fixed-point input format */
+#define Q15_WINDOW_SHIFT        (15 - Q15_INPUT_SHIFT)
+#define Q31_WINDOW_SHIFT        (Q31_INPUT_SHIFT - 15)
+
+/* Product is scaled up by multiplication, left shift of a negative value is undefined */
+#define Q31_WINDOW_SCALE        (1 << Q31_WINDOW_SHIFT)
+
+/* Fixed-point engines are built when selected and for the
+ * performance measurement, which compares all engines */
+#define BUILD_Q15_ENGINE        ((FFT_ENGINE == FFT_ENGINE_Q15) || (MEASURE_PERFORMANCE == 1))
+#define BUILD_Q31_ENGINE        ((FFT_ENGINE == FFT_ENGINE_Q31) || (MEASURE_PERFORMANCE == 1))
+
+/* Range of samples after DC removal */
+#define SAMPLE_MAX              ((1 << (AUDIO_SAMPLE_BITS - 1)) - 1)
+#define SAMPLE_MIN              (-(1 << (AUDIO_SAMPLE_BITS - 1)))
+
+/* State of one preprocessing pass over both segments of the window */
+typedef struct {
+    /* Coefficient of the next sample */
+    const q15_t* window;
+    size_t stride;
+    int16_t dc;
+    /* Sum of raw samples, it updates DC estimate after the pass */
+    int32_t sum;
+} fft_preprocess_t;
+
+/* Instances of every supported size, initialized once so switching
+ * FFT size at runtime is only a lookup */
+static fft_instance_t fft_plans[FFT_PLANS_COUNT];
+static bool fft_plans_ready = false;
+
+/* Window of MAX_SUPPORTED_FFT_SIZE, every other supported size takes every
+ * n-th coefficient of it. Window is periodic, so it is exact for all of them */
+static q15_t fft_window[MAX_SUPPORTED_FFT_SIZE];
+
+/* Inverse of the coherent gain of the window. Windowed input is scaled by it,
+ * so magnitude of a tone and all thresholds stay the same as without window */
+static float fft_window_gain = 1.0f;
+
+#if MEASURE_PERFORMANCE == 1
 /* Generates sin wave. Used for testing */
-static void generate_sin_wave(int32_t* res, size_t length);
+static void generate_sin_wave(int16_t* res, size_t length);
+static uint32_t spectrum_error(const float* res, const float* ref, size_t length);
+#endif
+static void fft_window_init(void);
+static void preprocess_begin(fft_preprocess_t* pp, const fft_dc_tracker_t* dc_tracker, size_t fft_size);
+static void preprocess_end(const fft_preprocess_t* pp, fft_dc_tracker_t* dc_tracker, size_t fft_size);
+static void preprocess_f32(fft_preprocess_t* pp, const int16_t* samples, size_t length, float scale, float* res);
+#if BUILD_Q15_ENGINE
+static void preprocess_q15(fft_preprocess_t* pp, const int16_t* samples, size_t length, q15_t* res);
+#endif
+#if BUILD_Q31_ENGINE
+static void preprocess_q31(fft_preprocess_t* pp, const int16_t* samples, size_t length, q31_t* res);
+#endif
+static void compute_rfft_magnitude(arm_rfft_fast_instance_f32* fft_obj, float* input, float* res, size_t fft_size);
+static void compute_rfft_split_f32(arm_rfft_fast_instance_f32* fft_obj, const int16_t* head, size_t head_size,
+                                   const int16_t* tail, fft_dc_tracker_t* dc_tracker, float* work, float* res,
+                                   size_t fft_size, size_t first_bin, size_t bins_count);
+#if BUILD_Q15_ENGINE
+static void compute_rfft_split_q15(arm_rfft_instance_q15* fft_obj, const int16_t* head, size_t head_size,
+                                   const int16_t* tail, fft_dc_tracker_t* dc_tracker, q15_t* work, float* res,
+                                   size_t fft_size, size_t first_bin, size_t bins_count);
+#endif
+#if BUILD_Q31_ENGINE
+static void compute_rfft_split_q31(arm_rfft_instance_q31* fft_obj, const int16_t* head, size_t head_size,
+                                   const int16_t* tail, fft_dc_tracker_t* dc_tracker, q31_t* work, float* res,
+                                   size_t fft_size, size_t first_bin, size_t bins_count);
+#endif
+
+arm_status fft_init(fft_instance_t* fft_obj, size_t fft_size)
+{
+#if FFT_ENGINE == FFT_ENGINE_Q15
+    return arm_rfft_init_q15(fft_obj, fft_size, IFFT_FLAG, BIT_REVERSE_FLAG);
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+    return arm_rfft_init_q31(fft_obj, fft_size, IFFT_FLAG, BIT_REVERSE_FLAG);
+#else
+    return arm_rfft_fast_init_f32(fft_obj, fft_size);
+#endif
+}
+
+/* Initializes instances of all supported sizes, twiddle and bit reversal
+ * tables are constant so each instance takes only a few words of RAM.
+ * Window table is built here too, it is not fast */
+arm_status fft_plans_init(void)
+{
+    arm_status arm_res;
+    size_t fft_size = MIN_SUPPORTED_FFT_SIZE;
+
+    fft_window_init();
+
+    for(size_t i = 0; i < FFT_PLANS_COUNT; i++)
+    {
+        arm_res = fft_init(&fft_plans[i], fft_size);
+        if(ARM_MATH_SUCCESS != arm_res)
+        {
+            return arm_res;
+        }
+        fft_size *= 2;
+    }
+
+    fft_plans_ready = true;
+
+    return ARM_MATH_SUCCESS;
+}
+
+/* Gives the cached instance of fft_size, NULL if the size is
+ * not supported or fft_plans_init() was not called */
+fft_instance_t* fft_get_plan(size_t fft_size)
+{
+    size_t plan_size = MIN_SUPPORTED_FFT_SIZE;
+
+    if(!fft_plans_ready)
+    {
+        return NULL;
+    }
+
+    for(size_t i = 0; i < FFT_PLANS_COUNT; i++)
+    {
+        if(plan_size == fft_size)
+        {
+            return &fft_plans[i];
+        }
+        plan_size *= 2;
+    }
+
+    return NULL;
+}
 
 void compute_rfft(arm_rfft_fast_instance_f32* fft_obj, int32_t* input, float* res, size_t fft_size)
 {
@@ -16,68 +153,128 @@ void compute_rfft(arm_rfft_fast_instance_f32* fft_obj, int32_t* input, float* re
      */
     arm_q31_to_float(input, (float*)input, fft_size);
 
-    /* Calculate FFT */
-    arm_rfft_fast_f32(fft_obj, (float*)input, res, IFFT_FLAG);
+    compute_rfft_magnitude(fft_obj, (float*)input, res, fft_size);
+}
 
-    /* Calculate magnitude */
-    /* arm_cmplx_mag_f32 for every element does the following:
-     *      pDst[n] = sqrt(pSrc[(2*n)+0]^2 + pSrc[(2*n)+1]^2);
-     *
-     * So:
-     *      pDst[0] is created from pSrc[0] and pSrc[1]
-     *      pDst[1] is created from pSrc[2] and pSrc[2]
-     *      pDst[2] is created from pSrc[4] and pSrc[5]
-     *
-     * So it should be safe to use same buffer as input ad output
-     * parameters to save some memory
-     */
-    /* TODO: arm_cmplx_mag_squared_f32 and arm_cmplx_mag_f32 do the same thing
-     * except that arm_cmplx_mag_squared_f32 does not calculate sqrt() so it
-     * executes faster, but it will make results more spread out.
-     * Need to check if this change is applicable.
-     */
-    arm_cmplx_mag_f32(res, res, fft_size);
+/* Computes power spectrum (squared magnitude) of the signal.
+ * Input samples are given as two segments (head followed by tail) and are
+ * not modified, so overlapping windows can be taken straight from the
+ * capture ring without copying them. In the same pass that converts them
+ * to the engine input DC estimate of dc_tracker is subtracted and FFT_WINDOW
+ * is applied, then the estimate is updated with mean of the window.
+ * dc_tracker can be NULL, then DC is not removed.
+ * Only bins_count bins starting from first_bin are computed, the rest of
+ * res buffer contains "garbage" data.
+ * work buffer must have FFT_WORK_SIZE(fft_size) elements.
+ * FFT_ENGINE selects the engine, every engine gives power
+ * in the same scale as the float one */
+void compute_rfft_split(fft_instance_t* fft_obj, const int16_t* head, size_t head_size,
+                        const int16_t* tail, fft_dc_tracker_t* dc_tracker, fft_work_t* work, float* res,
+                        size_t fft_size, size_t first_bin, size_t bins_count)
+{
+#if FFT_ENGINE == FFT_ENGINE_Q15
+    compute_rfft_split_q15(fft_obj, head, head_size, tail, dc_tracker, work, res, fft_size, first_bin, bins_count);
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+    compute_rfft_split_q31(fft_obj, head, head_size, tail, dc_tracker, work, res, fft_size, first_bin, bins_count);
+#else
+    compute_rfft_split_f32(fft_obj, head, head_size, tail, dc_tracker, work, res, fft_size, first_bin, bins_count);
+#endif
 }
 
-arm_status measure_fft_performance(cyhal_timer_t* timer_obj)
+#if MEASURE_PERFORMANCE == 1
+/* Every engine is compared with the float engine, whichever FFT_ENGINE selects.
+ * Buffers are borrowed from the analysis, which doesn't run yet: work must have
+ * FFT_MEASURE_WORK_SIZE(FFT_MAX_SIZE) elements, ref and res FFT_MAX_SIZE elements */
+arm_status measure_fft_performance(cyhal_timer_t* timer_obj, fft_measure_work_t* work, float* ref, float* res)
 {
     arm_status arm_res;
 
-    /* Buffers for input signal and FFT result */
-    int32_t input_signal[MAX_SUPPORTED_FFT_SIZE];
-    float fft_res[MAX_SUPPORTED_FFT_SIZE];
+    /* Test signal, it is not a part of the analysis buffers */
+    static int16_t input_signal[FFT_MAX_SIZE];
+
+    /* Create FFT structures */
+    arm_rfft_fast_instance_f32 fft_f32_obj;
+    arm_rfft_instance_q15 fft_q15_obj;
+    arm_rfft_instance_q31 fft_q31_obj;
 
     /* Print to make results standout */
     printf("\r\n\n");
     printf("####################### FFT performance testing results #######################\r\n");
-    printf("\r\nFFT size\tduration (us)\r\n");
+    printf("\r\nDuration in us, error of power spectrum is relative to float engine in %%\r\n");
+    printf("f32 mag is float engine that computes magnitude of every bin\r\n");
+    printf("\r\nFFT size\tf32 mag\t\tf32\t\tq15\t\tq15 error\tq31\t\tq31 error\r\n");
 
-    for(size_t fft_size = MIN_SUPPORTED_FFT_SIZE; fft_size <= MAX_SUPPORTED_FFT_SIZE; fft_size *= 2)
+    for(size_t fft_size = MIN_SUPPORTED_FFT_SIZE; fft_size <= FFT_MAX_SIZE; fft_size *= 2)
     {
+        uint32_t mag_duration;
+        uint32_t f32_duration;
+        uint32_t q15_duration;
+        uint32_t q15_error;
+        uint32_t q31_duration;
+        uint32_t q31_error;
+        fft_preprocess_t pp;
+
         /* Generate input signal */
         generate_sin_wave(input_signal, fft_size);
 
-        /* Create and initialize FFT structure */
-        arm_rfft_fast_instance_f32 fft_tests_obj;
-        arm_res = arm_rfft_fast_init_f32(&fft_tests_obj, fft_size);
+        /* Initialize FFT structures */
+        arm_res = arm_rfft_fast_init_f32(&fft_f32_obj, fft_size);
+        if(ARM_MATH_SUCCESS != arm_res)
+        {
+            return arm_res;
+        }
+        arm_res = arm_rfft_init_q15(&fft_q15_obj, fft_size, IFFT_FLAG, BIT_REVERSE_FLAG);
+        if(ARM_MATH_SUCCESS != arm_res)
+        {
+            return arm_res;
+        }
+        arm_res = arm_rfft_init_q31(&fft_q31_obj, fft_size, IFFT_FLAG, BIT_REVERSE_FLAG);
         if(ARM_MATH_SUCCESS != arm_res)
         {
             return arm_res;
         }
 
-        /* Reset the timer to avoid overflow */
+        /* Float engine, its result is used as reference. Output of the
+         * fixed-point engines is not there yet, so res is its work buffer */
         cyhal_timer_stop(timer_obj);
         cyhal_timer_reset(timer_obj);
         cyhal_timer_start(timer_obj);
+        compute_rfft_split_f32(&fft_f32_obj, input_signal, fft_size, NULL, NULL, res, ref, fft_size, 0,
+                               fft_size / 2);
+        f32_duration = cyhal_timer_read(timer_obj);
 
-        /* Compute FFT */
-        compute_rfft(&fft_tests_obj, input_signal, fft_res, fft_size);
+        /* Work buffer is sized for Q31, so Q15 engine fits in it too */
+        cyhal_timer_stop(timer_obj);
+        cyhal_timer_reset(timer_obj);
+        cyhal_timer_start(timer_obj);
+        compute_rfft_split_q15(&fft_q15_obj, input_signal, fft_size, NULL, NULL, (q15_t*)work, res, fft_size, 0,
+                               fft_size / 2);
+        q15_duration = cyhal_timer_read(timer_obj);
+        q15_error = spectrum_error(res, ref, fft_size / 2);
 
-        /* Read timer value */
-        uint32_t fft_duration = cyhal_timer_read(timer_obj);
+        cyhal_timer_stop(timer_obj);
+        cyhal_timer_reset(timer_obj);
+        cyhal_timer_start(timer_obj);
+        compute_rfft_split_q31(&fft_q31_obj, input_signal, fft_size, NULL, NULL, work, res, fft_size, 0,
+                               fft_size / 2);
+        q31_duration = cyhal_timer_read(timer_obj);
+        q31_error = spectrum_error(res, ref, fft_size / 2);
+
+        /* Float engine with magnitude of every bin, as it was done before
+         * power spectrum. Reference is not needed anymore, so it holds the input */
+        cyhal_timer_stop(timer_obj);
+        cyhal_timer_reset(timer_obj);
+        cyhal_timer_start(timer_obj);
+        preprocess_begin(&pp, NULL, fft_size);
+        preprocess_f32(&pp, input_signal, fft_size, (FLOAT_ENGINE_SCALE / 32768.0f) * fft_window_gain, ref);
+        compute_rfft_magnitude(&fft_f32_obj, ref, res, fft_size);
+        mag_duration = cyhal_timer_read(timer_obj);
 
         /* Print FFT performance results */
-        printf("%u\t\t%lu\r\n", fft_size, fft_duration);
+        printf("%u\t\t%lu\t\t%lu\t\t%lu\t\t%lu.%02lu\t\t%lu\t\t%lu.%02lu\r\n", (unsigned)fft_size,
+               (unsigned long)mag_duration, (unsigned long)f32_duration,
+               (unsigned long)q15_duration, (unsigned long)(q15_error / 100), (unsigned long)(q15_error % 100),
+               (unsigned long)q31_duration, (unsigned long)(q31_error / 100), (unsigned long)(q31_error % 100));
     }
 
     /* Print to make results standout */
@@ -87,13 +284,332 @@ arm_status measure_fft_performance(cyhal_timer_t* timer_obj)
     return ARM_MATH_SUCCESS;
 }
 
-static void generate_sin_wave(int32_t* res, size_t length)
+static void generate_sin_wave(int16_t* res, size_t length)
 {
-    /* Generate sin wave with frequency = length */
+    /* Generate sin wave with frequency = length
+     * and amplitude of full ADC range */
     float frequency = (2 * PI) / length;
-    int32_t amplitude = INT32_MAX;
+    int32_t amplitude = (1 << (AUDIO_SAMPLE_BITS - 1)) - 1;
     for (size_t i = 0; i < length; i++)
     {
         res[i] = amplitude * sin(frequency * i);
     }
 }
+
+/* Sum of absolute differences relative to sum of reference values,
+ * in hundredths of % so it can be printed without float support */
+static uint32_t spectrum_error(const float* res, const float* ref, size_t length)
+{
+    float diff = 0;
+    float total = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        diff += fabsf(res[i] - ref[i]);
+        total += fabsf(ref[i]);
+    }
+
+    return (total > 0) ? (uint32_t)(diff * 10000 / total) : 0;
+}
+#endif
+
+static void compute_rfft_split_f32(arm_rfft_fast_instance_f32* fft_obj, const int16_t* head, size_t head_size,
+                                   const int16_t* tail, fft_dc_tracker_t* dc_tracker, float* work, float* res,
+                                   size_t fft_size, size_t first_bin, size_t bins_count)
+{
+    /* Samples are taken as Q31 the same way as arm_q31_to_float() did with
+     * 32 bit samples, so float engine keeps its scale */
+    const float scale = (FLOAT_ENGINE_SCALE / 32768.0f) * fft_window_gain;
+    fft_preprocess_t pp;
+
+    /* Remove DC, apply window and convert to float, this pass also joins both segments */
+    preprocess_begin(&pp, dc_tracker, fft_size);
+    preprocess_f32(&pp, head, head_size, scale, work);
+    if(head_size < fft_size)
+    {
+        preprocess_f32(&pp, tail, fft_size - head_size, scale, &work[head_size]);
+    }
+    preprocess_end(&pp, dc_tracker, fft_size);
+
+    /* Calculate FFT */
+    arm_rfft_fast_f32(fft_obj, work, res, IFFT_FLAG);
+
+    /* Calculate power of requested bins only.
+     * Same as for arm_cmplx_mag_f32, bin n is created from values 2*n and 2*n+1
+     * so it is safe to use same buffer as input and output */
+    arm_cmplx_mag_squared_f32(&res[2 * first_bin], &res[first_bin], bins_count);
+}
+
+/* Fixed-point engines.
+ * ADC gives only AUDIO_SAMPLE_BITS bits, so samples are shifted to the
+ * full range of Q15/Q31 and transformed without float conversion.
+ * arm_rfft_q15/q31 scale output down by fft_size and
+ * arm_cmplx_mag_squared_q15/q31 give result in 3.13/3.29 format, so power p
+ * of the sample sum equals p * 2^17 * fft_size^2 for Q15 and
+ * p * 2^33 * fft_size^2 for Q31. Only requested bins are converted to float
+ * with a single scale that matches the float engine:
+ *      res = p * 2^(17 or 33) * (fft_size / 2^(input shift) / 2^31)^2
+ * multiplied by the square of the window gain
+ *
+ * RFFT output is 2 * fft_size fixed-point values, work buffer holds
+ * input followed by RFFT output. res is written only as float */
+#if BUILD_Q15_ENGINE
+static void compute_rfft_split_q15(arm_rfft_instance_q15* fft_obj, const int16_t* head, size_t head_size,
+                                   const int16_t* tail, fft_dc_tracker_t* dc_tracker, q15_t* work, float* res,
+                                   size_t fft_size, size_t first_bin, size_t bins_count)
+{
+    q15_t* input = work;
+    q15_t* output = &work[fft_size];
+    q15_t* power = work;
+    const float magnitude_scale = ((float)fft_size / (1 << Q15_INPUT_SHIFT)) * FLOAT_ENGINE_SCALE;
+    const float scale = magnitude_scale * magnitude_scale * 131072.0f * fft_window_gain * fft_window_gain;
+    fft_preprocess_t pp;
+
+    /* Remove DC, apply window and convert to Q15, this pass also joins both segments */
+    preprocess_begin(&pp, dc_tracker, fft_size);
+    preprocess_q15(&pp, head, head_size, input);
+    if(head_size < fft_size)
+    {
+        preprocess_q15(&pp, tail, fft_size - head_size, &input[head_size]);
+    }
+    preprocess_end(&pp, dc_tracker, fft_size);
+
+    arm_rfft_q15(fft_obj, input, output);
+
+    /* Input is not needed anymore, so power is stored in place of it */
+    arm_cmplx_mag_squared_q15(&output[2 * first_bin], &power[first_bin], bins_count);
+
+    for(size_t i = first_bin; i < (first_bin + bins_count); i++)
+    {
+        res[i] = power[i] * scale;
+    }
+}
+#endif
+
+#if BUILD_Q31_ENGINE
+static void compute_rfft_split_q31(arm_rfft_instance_q31* fft_obj, const int16_t* head, size_t head_size,
+                                   const int16_t* tail, fft_dc_tracker_t* dc_tracker, q31_t* work, float* res,
+                                   size_t fft_size, size_t first_bin, size_t bins_count)
+{
+    q31_t* input = work;
+    q31_t* output = &work[fft_size];
+    q31_t* power = work;
+    const float magnitude_scale = ((float)fft_size / (1 << Q31_INPUT_SHIFT)) * FLOAT_ENGINE_SCALE;
+    const float scale = magnitude_scale * magnitude_scale * 8589934592.0f * fft_window_gain * fft_window_gain;
+    fft_preprocess_t pp;
+
+    /* Remove DC, apply window and convert to Q31, this pass also joins both segments */
+    preprocess_begin(&pp, dc_tracker, fft_size);
+    preprocess_q31(&pp, head, head_size, input);
+    if(head_size < fft_size)
+    {
+        preprocess_q31(&pp, tail, fft_size - head_size, &input[head_size]);
+    }
+    preprocess_end(&pp, dc_tracker, fft_size);
+
+    arm_rfft_q31(fft_obj, input, output);
+
+    /* Input is not needed anymore, so power is stored in place of it */
+    arm_cmplx_mag_squared_q31(&output[2 * first_bin], &power[first_bin], bins_count);
+
+    for(size_t i = first_bin; i < (first_bin + bins_count); i++)
+    {
+        res[i] = power[i] * scale;
+    }
+}
+#endif
+
+/* Builds FFT_WINDOW table in Q15 and its gain */
+static void fft_window_init(void)
+{
+    float sum = 0;
+
+    for(size_t n = 0; n < MAX_SUPPORTED_FFT_SIZE; n++)
+    {
+        float phase = (2 * PI * n) / MAX_SUPPORTED_FFT_SIZE;
+#if FFT_WINDOW == FFT_WINDOW_BLACKMAN
+        float coefficient = 0.42f - (0.5f * cosf(phase)) + (0.08f * cosf(2 * phase));
+#else
+        float coefficient = 0.5f - (0.5f * cosf(phase));
+#endif
+        fft_window[n] = (q15_t)lroundf(coefficient * 32767.0f);
+        sum += fft_window[n];
+    }
+
+    /* Coherent gain is the mean coefficient */
+    fft_window_gain = (32768.0f * MAX_SUPPORTED_FFT_SIZE) / sum;
+}
+
+static void preprocess_begin(fft_preprocess_t* pp, const fft_dc_tracker_t* dc_tracker, size_t fft_size)
+{
+    pp->window = fft_window;
+    pp->stride = MAX_SUPPORTED_FFT_SIZE / fft_size;
+    pp->dc = (NULL != dc_tracker) ?
+             (int16_t)((dc_tracker->dc + (1 << (FFT_DC_FRACTION_BITS - 1))) >> FFT_DC_FRACTION_BITS) : 0;
+    pp->sum = 0;
+}
+
+/* DC drifts slowly, so mean of every window is averaged
+ * over 2^FFT_DC_TRACKING_SHIFT windows. The first window sets it right away */
+static void preprocess_end(const fft_preprocess_t* pp, fft_dc_tracker_t* dc_tracker, size_t fft_size)
+{
+    if(NULL == dc_tracker)
+    {
+        return;
+    }
+
+    int32_t mean = (int32_t)(((int64_t)pp->sum << FFT_DC_FRACTION_BITS) / (int32_t)fft_size);
+    if(dc_tracker->primed)
+    {
+        dc_tracker->dc += (mean - dc_tracker->dc) >> FFT_DC_TRACKING_SHIFT;
+    }
+    else
+    {
+        dc_tracker->dc = mean;
+        dc_tracker->primed = true;
+    }
+}
+
+/* Preprocessing kernels. Every sample is added to the sum, DC is subtracted,
+ * result is saturated to ADC range and multiplied by window coefficient,
+ * the product is converted to the engine input format.
+ * With DSP extension (Cortex-M4) two samples are loaded, summed, shifted
+ * and saturated at once, the rest of the samples goes through scalar code */
+#if defined(ARM_MATH_DSP)
+static inline uint32_t preprocess_pair(fft_preprocess_t* pp, const int16_t* samples, uint32_t dc_pair)
+{
+    uint32_t pair;
+
+    /* memcpy is legal for any alignment, it still becomes one word load */
+    memcpy(&pair, samples, sizeof(pair));
+    pp->sum = __SMLAD(pair, 0x00010001, pp->sum);
+
+    return __SSAT16(__QSUB16(pair, dc_pair), AUDIO_SAMPLE_BITS);
+}
+
+/* Multiplies low and high sample of the pair by their coefficients */
+#define PAIR_PRODUCT_LOW(pair, coefficient)     ((int32_t)__SMUAD((pair), (uint16_t)(coefficient)))
+#define PAIR_PRODUCT_HIGH(pair, coefficient)    ((int32_t)__SMUAD((pair), (uint32_t)(uint16_t)(coefficient) << 16))
+#endif
+
+static inline int32_t preprocess_sample(fft_preprocess_t* pp, int16_t sample)
+{
+    int32_t value = sample - pp->dc;
+
+    pp->sum += sample;
+    if(value > SAMPLE_MAX)
+    {
+        value = SAMPLE_MAX;
+    }
+    else if(value < SAMPLE_MIN)
+    {
+        value = SAMPLE_MIN;
+    }
+
+    return value;
+}
+
+static void preprocess_f32(fft_preprocess_t* pp, const int16_t* samples, size_t length, float scale, float* res)
+{
+    const q15_t* window = pp->window;
+    const size_t stride = pp->stride;
+    size_t i = 0;
+
+#if defined(ARM_MATH_DSP)
+    const uint32_t dc_pair = __PKHBT((uint16_t)pp->dc, (uint32_t)pp->dc, 16);
+    for(; (i + 1) < length; i += 2)
+    {
+        uint32_t pair = preprocess_pair(pp, &samples[i], dc_pair);
+        res[i] = (float)PAIR_PRODUCT_LOW(pair, window[0]) * scale;
+        res[i + 1] = (float)PAIR_PRODUCT_HIGH(pair, window[stride]) * scale;
+        window += 2 * stride;
+    }
+#endif
+
+    for(; i < length; i++)
+    {
+        res[i] = (float)(preprocess_sample(pp, samples[i]) * window[0]) * scale;
+        window += stride;
+    }
+
+    pp->window = window;
+}
+
+#if BUILD_Q15_ENGINE
+static void preprocess_q15(fft_preprocess_t* pp, const int16_t* samples, size_t length, q15_t* res)
+{
+    const q15_t* window = pp->window;
+    const size_t stride = pp->stride;
+    size_t i = 0;
+
+#if defined(ARM_MATH_DSP)
+    const uint32_t dc_pair = __PKHBT((uint16_t)pp->dc, (uint32_t)pp->dc, 16);
+    for(; (i + 1) < length; i += 2)
+    {
+        uint32_t pair = preprocess_pair(pp, &samples[i], dc_pair);
+        res[i] = (q15_t)(PAIR_PRODUCT_LOW(pair, window[0]) >> Q15_WINDOW_SHIFT);
+        res[i + 1] = (q15_t)(PAIR_PRODUCT_HIGH(pair, window[stride]) >> Q15_WINDOW_SHIFT);
+        window += 2 * stride;
+    }
+#endif
+
+    for(; i < length; i++)
+    {
+        res[i] = (q15_t)((preprocess_sample(pp, samples[i]) * window[0]) >> Q15_WINDOW_SHIFT);
+        window += stride;
+    }
+
+    pp->window = window;
+}
+#endif
+
+#if BUILD_Q31_ENGINE
+static void preprocess_q31(fft_preprocess_t* pp, const int16_t* samples, size_t length, q31_t* res)
+{
+    const q15_t* window = pp->window;
+    const size_t stride = pp->stride;
+    size_t i = 0;
+
+#if defined(ARM_MATH_DSP)
+    const uint32_t dc_pair = __PKHBT((uint16_t)pp->dc, (uint32_t)pp->dc, 16);
+    for(; (i + 1) < length; i += 2)
+    {
+        uint32_t pair = preprocess_pair(pp, &samples[i], dc_pair);
+        res[i] = PAIR_PRODUCT_LOW(pair, window[0]) * Q31_WINDOW_SCALE;
+        res[i + 1] = PAIR_PRODUCT_HIGH(pair, window[stride]) * Q31_WINDOW_SCALE;
+        window += 2 * stride;
+    }
+#endif
+
+    for(; i < length; i++)
+    {
+        res[i] = (preprocess_sample(pp, samples[i]) * window[0]) * Q31_WINDOW_SCALE;
+        window += stride;
+    }
+
+    pp->window = window;
+}
+#endif
+
+/* Calculates FFT of float input and magnitude of every bin */
+static void compute_rfft_magnitude(arm_rfft_fast_instance_f32* fft_obj, float* input, float* res, size_t fft_size)
+{
+    /* Calculate FFT */
+    arm_rfft_fast_f32(fft_obj, input, res, IFFT_FLAG);
+
+    /* Calculate magnitude */
+    /* arm_cmplx_mag_f32 for every element does the following:
+     *      pDst[n] = sqrt(pSrc[(2*n)+0]^2 + pSrc[(2*n)+1]^2);
+     *
+     * So:
+     *      pDst[0] is created from pSrc[0] and pSrc[1]
+     *      pDst[1] is created from pSrc[2] and pSrc[2]
+     *      pDst[2] is created from pSrc[4] and pSrc[5]
+     *
+     * So it should be safe to use same buffer as input ad output
+     * parameters to save some memory
+     */
+    /* compute_rfft_split() uses arm_cmplx_mag_squared_f32 instead, so sqrt()
+     * is done once per band by the visualizer and not for every bin */
+    /* Real FFT of fft_size samples gives fft_size / 2 complex values */
+    arm_cmplx_mag_f32(res, res, fft_size / 2);
+}
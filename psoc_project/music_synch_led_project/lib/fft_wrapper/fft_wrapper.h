@@ -1,13 +1,63 @@
 #ifndef __FFT_WRAPPER_H__
 #define __FFT_WRAPPER_H__
 
+#include <stdbool.h>
 #include "arm_math.h"
 /* TODO: check if this include is needed */
 #include "arm_const_structs.h"
 #include "app_config.h"
 #include "cyhal.h"
 
+/* FFT instance, work buffer element and size of work buffer for the selected engine.
+ * Work buffer holds samples of the engine's own type, fixed-point engines keep
+ * fft_size input samples followed by 2 * fft_size RFFT output values in it */
+#if FFT_ENGINE == FFT_ENGINE_Q15
+typedef arm_rfft_instance_q15 fft_instance_t;
+typedef q15_t fft_work_t;
+#define FFT_WORK_SIZE(fft_size)         (3 * (fft_size))
+#elif FFT_ENGINE == FFT_ENGINE_Q31
+typedef arm_rfft_instance_q31 fft_instance_t;
+typedef q31_t fft_work_t;
+#define FFT_WORK_SIZE(fft_size)         (3 * (fft_size))
+#else
+typedef arm_rfft_fast_instance_f32 fft_instance_t;
+typedef float fft_work_t;
+#define FFT_WORK_SIZE(fft_size)         (fft_size)
+#endif
+
+#if MEASURE_PERFORMANCE == 1
+/* Performance measurement runs every engine, so its work buffer
+ * is sized for the largest one, Q31 with 3 * fft_size values */
+typedef q31_t fft_measure_work_t;
+#define FFT_MEASURE_WORK_SIZE(fft_size) (3 * (fft_size))
+#endif
+
+/* Running DC estimate of one input stream in ADC units with FFT_DC_FRACTION_BITS
+ * fractional bits. Every stream keeps its own, a zeroed one is primed by the first window */
+#define FFT_DC_FRACTION_BITS            (8)
+
+typedef struct {
+    int32_t dc;
+    bool primed;
+} fft_dc_tracker_t;
+
+/* Plan cache holds one FFT instance for every power of 2
+ * from MIN_SUPPORTED_FFT_SIZE to MAX_SUPPORTED_FFT_SIZE */
+#define FFT_PLANS_COUNT                 (8)
+
+#if (MIN_SUPPORTED_FFT_SIZE << (FFT_PLANS_COUNT - 1)) != MAX_SUPPORTED_FFT_SIZE
+#error "FFT_PLANS_COUNT doesn't match the supported FFT sizes"
+#endif
+
+arm_status fft_init(fft_instance_t* fft_obj, size_t fft_size);
+arm_status fft_plans_init(void);
+fft_instance_t* fft_get_plan(size_t fft_size);
 void compute_rfft(arm_rfft_fast_instance_f32* fft_obj, int32_t* input, float* res, size_t fft_size);
-arm_status measure_fft_performance(cyhal_timer_t* timer_obj);
+void compute_rfft_split(fft_instance_t* fft_obj, const int16_t* head, size_t head_size,
+                        const int16_t* tail, fft_dc_tracker_t* dc_tracker, fft_work_t* work, float* res,
+                        size_t fft_size, size_t first_bin, size_t bins_count);
+#if MEASURE_PERFORMANCE == 1
+arm_status measure_fft_performance(cyhal_timer_t* timer_obj, fft_measure_work_t* work, float* ref, float* res);
+#endif
 
 #endif /* __FFT_WRAPPER_H__ */
@@ -0,0 +1,128 @@
+#include "frame_scheduler.h"
+#include "cyhal.h"
+#include "trace.h"
+#include <string.h>
+/* Free RTOS */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Deadlines are on the FreeRTOS tick grid, every second is split into
+ * frame_rate intervals which may differ by one tick if rate doesn't divide
+ * the tick rate. Grid is rebased every second so math never overflows */
+static TickType_t scheduler_second_start;
+static uint32_t scheduler_frame_index;
+static uint32_t scheduler_frame_rate;
+
+/* Start of the previous frame in trace timestamps (us) and its deadline */
+static uint32_t scheduler_last_start;
+static TickType_t scheduler_last_deadline;
+static bool scheduler_last_valid = false;
+
+static frame_scheduler_stats_t scheduler_stats;
+
+static TickType_t frame_scheduler_deadline(void);
+static void frame_scheduler_advance(void);
+
+/* First frame is due right away */
+frame_scheduler_res_t frame_scheduler_init(uint32_t frame_rate)
+{
+    if((0 == frame_rate) || (frame_rate > configTICK_RATE_HZ))
+    {
+        return frame_scheduler_error_invalid_rate;
+    }
+
+    scheduler_frame_rate = frame_rate;
+    scheduler_frame_index = 0;
+    scheduler_second_start = xTaskGetTickCount();
+    scheduler_last_valid = false;
+    memset(&scheduler_stats, 0, sizeof(scheduler_stats));
+
+    return frame_scheduler_success;
+}
+
+/* Blocks until the deadline of the next frame. Deadlines that passed
+ * while the previous frame was rendered are skipped, so output stays
+ * on the grid instead of slipping or catching up with a burst */
+void frame_scheduler_wait(void)
+{
+    TickType_t now = xTaskGetTickCount();
+    uint32_t missed = 0;
+
+    while((int32_t)(now - frame_scheduler_deadline()) > 0)
+    {
+        missed++;
+        frame_scheduler_advance();
+    }
+
+    TickType_t deadline = frame_scheduler_deadline();
+    if(deadline != now)
+    {
+        vTaskDelay(deadline - now);
+    }
+
+    uint32_t start = trace_get_timestamp();
+    uint32_t jitter = 0;
+    bool jitter_valid = false;
+
+    /* Interval to the previous frame is compared with the scheduled one,
+     * only when no deadline was skipped in between */
+    if(scheduler_last_valid && (0 == missed))
+    {
+        uint32_t interval = start - scheduler_last_start;
+        uint32_t scheduled = ((deadline - scheduler_last_deadline) * 1000000u) / configTICK_RATE_HZ;
+        jitter = (interval > scheduled) ? (interval - scheduled) : (scheduled - interval);
+        jitter_valid = true;
+    }
+
+    scheduler_last_start = start;
+    scheduler_last_deadline = deadline;
+    scheduler_last_valid = true;
+    frame_scheduler_advance();
+
+    /* Stats are read by other task */
+    uint32_t critical_section = cyhal_system_critical_section_enter();
+    scheduler_stats.frames++;
+    scheduler_stats.missed_deadlines += missed;
+    if(jitter_valid)
+    {
+        scheduler_stats.jitter_sum += jitter;
+        scheduler_stats.jitter_count++;
+        if(jitter > scheduler_stats.jitter_max)
+        {
+            scheduler_stats.jitter_max = jitter;
+        }
+    }
+    cyhal_system_critical_section_exit(critical_section);
+}
+
+/* Called when the current frame has no new analysis and reuses the previous one */
+void frame_scheduler_count_stale(void)
+{
+    uint32_t critical_section = cyhal_system_critical_section_enter();
+    scheduler_stats.stale_frames++;
+    cyhal_system_critical_section_exit(critical_section);
+}
+
+/* Copies counters and starts counting from zero */
+void frame_scheduler_get_stats(frame_scheduler_stats_t* stats)
+{
+    uint32_t critical_section = cyhal_system_critical_section_enter();
+    *stats = scheduler_stats;
+    memset(&scheduler_stats, 0, sizeof(scheduler_stats));
+    cyhal_system_critical_section_exit(critical_section);
+}
+
+static TickType_t frame_scheduler_deadline(void)
+{
+    return scheduler_second_start + ((scheduler_frame_index * configTICK_RATE_HZ) / scheduler_frame_rate);
+}
+
+static void frame_scheduler_advance(void)
+{
+    scheduler_frame_index++;
+    if(scheduler_frame_index == scheduler_frame_rate)
+    {
+        scheduler_frame_index = 0;
+        scheduler_second_start += configTICK_RATE_HZ;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef __FRAME_SCHEDULER_H__
+#define __FRAME_SCHEDULER_H__
+
+#include "app_config.h"
+#include <stdint.h>
+
+typedef enum
+{
+    frame_scheduler_success,
+    frame_scheduler_error_invalid_rate
+} frame_scheduler_res_t;
+
+/* Counters since the previous frame_scheduler_get_stats() call */
+typedef struct {
+    uint32_t frames;
+    /* Frames that reused spectrum of the previous frame */
+    uint32_t stale_frames;
+    /* Deadlines skipped because previous frame was still being rendered */
+    uint32_t missed_deadlines;
+    /* Difference between actual and scheduled interval of consecutive frames in us */
+    uint32_t jitter_max;
+    uint32_t jitter_sum;
+    uint32_t jitter_count;
+} frame_scheduler_stats_t;
+
+frame_scheduler_res_t frame_scheduler_init(uint32_t frame_rate);
+void frame_scheduler_wait(void);
+void frame_scheduler_count_stale(void);
+void frame_scheduler_get_stats(frame_scheduler_stats_t* stats);
+
+#endif /* __FRAME_SCHEDULER_H__ */
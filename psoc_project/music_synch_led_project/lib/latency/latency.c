@@ -0,0 +1,95 @@
+#include "latency.h"
+#include "cyhal.h"
+#include <string.h>
+
+/* Histogram with fixed buckets, so recording is O(1) and can be done from ISR */
+typedef struct {
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t last;
+} latency_histogram_t;
+
+static latency_histogram_t latency_histogram = {
+    .min = UINT32_MAX
+};
+
+static uint32_t latency_percentile(uint32_t count, uint32_t max, uint32_t percent);
+
+/* Adds latency of one frame in us. Can be called from tasks and ISRs */
+void latency_record(uint32_t latency)
+{
+    uint32_t bucket = latency / LATENCY_BUCKET_US;
+    if(bucket >= LATENCY_BUCKETS)
+    {
+        bucket = LATENCY_BUCKETS - 1;
+    }
+
+    uint32_t critical_section = cyhal_system_critical_section_enter();
+    latency_histogram.buckets[bucket]++;
+    latency_histogram.count++;
+    if(latency < latency_histogram.min)
+    {
+        latency_histogram.min = latency;
+    }
+    if(latency > latency_histogram.max)
+    {
+        latency_histogram.max = latency;
+    }
+    latency_histogram.last = latency;
+    cyhal_system_critical_section_exit(critical_section);
+}
+
+/* Histogram keeps counting while percentiles are computed, so frames
+ * recorded in the meantime may move them slightly towards faster ones */
+void latency_get_stats(latency_stats_t* stats)
+{
+    uint32_t critical_section = cyhal_system_critical_section_enter();
+    stats->count = latency_histogram.count;
+    stats->min = latency_histogram.min;
+    stats->max = latency_histogram.max;
+    stats->last = latency_histogram.last;
+    stats->overflows = latency_histogram.buckets[LATENCY_BUCKETS - 1];
+    cyhal_system_critical_section_exit(critical_section);
+
+    if(0 == stats->count)
+    {
+        stats->min = 0;
+        stats->p50 = 0;
+        stats->p95 = 0;
+        stats->p99 = 0;
+        return;
+    }
+
+    stats->p50 = latency_percentile(stats->count, stats->max, 50);
+    stats->p95 = latency_percentile(stats->count, stats->max, 95);
+    stats->p99 = latency_percentile(stats->count, stats->max, 99);
+}
+
+void latency_reset(void)
+{
+    uint32_t critical_section = cyhal_system_critical_section_enter();
+    memset(&latency_histogram, 0, sizeof(latency_histogram));
+    latency_histogram.min = UINT32_MAX;
+    cyhal_system_critical_section_exit(critical_section);
+}
+
+/* Upper edge of the bucket in which the given share of count frames is reached */
+static uint32_t latency_percentile(uint32_t count, uint32_t max, uint32_t percent)
+{
+    uint32_t rank = (uint32_t)((((uint64_t)count * percent) + 99) / 100);
+    uint32_t sum = 0;
+
+    for(uint32_t bucket = 0; bucket < (LATENCY_BUCKETS - 1); bucket++)
+    {
+        sum += latency_histogram.buckets[bucket];
+        if(sum >= rank)
+        {
+            uint32_t edge = (bucket + 1) * LATENCY_BUCKET_US;
+            return (edge < max) ? edge : max;
+        }
+    }
+
+    return max;
+}
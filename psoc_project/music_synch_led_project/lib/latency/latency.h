@@ -0,0 +1,26 @@
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include "app_config.h"
+#include <stdint.h>
+
+/* Audio to light latency of the frames recorded since start or the last reset, in us.
+ * Percentiles are upper edges of their histogram buckets, so they are
+ * up to LATENCY_BUCKET_US above the exact value and never above max */
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t last;
+    uint32_t p50;
+    uint32_t p95;
+    uint32_t p99;
+    /* Frames that fell into the last bucket, longer than the histogram range */
+    uint32_t overflows;
+} latency_stats_t;
+
+void latency_record(uint32_t latency);
+void latency_get_stats(latency_stats_t* stats);
+void latency_reset(void);
+
+#endif /* __LATENCY_H__ */
@@ -0,0 +1,104 @@
+#include "led_matrix.h"
+
+/* LED index of every pixel, so drawing doesn't depend on wiring and
+ * rotation. Pixel (0, 0) is in the bottom left corner of the drawing area */
+static uint16_t led_matrix_map[LED_MATRIX_ROWS][LED_MATRIX_COLUMNS];
+
+/* Builds pixel to LED table. Panel LED 0 is in its top left corner and the first row
+ * runs to the right, drawing area is turned clockwise by LED_MATRIX_ROTATION on it */
+void led_matrix_init(void)
+{
+    for(uint16_t y = 0; y < LED_MATRIX_ROWS; y++)
+    {
+        /* Row of the drawing area counted from the top */
+        uint16_t top_y = (LED_MATRIX_ROWS - 1) - y;
+
+        for(uint16_t x = 0; x < LED_MATRIX_COLUMNS; x++)
+        {
+            uint16_t panel_x;
+            uint16_t panel_y;
+
+#if LED_MATRIX_ROTATION == 90
+            panel_x = y;
+            panel_y = x;
+#elif LED_MATRIX_ROTATION == 180
+            panel_x = (LED_MATRIX_COLUMNS - 1) - x;
+            panel_y = y;
+#elif LED_MATRIX_ROTATION == 270
+            panel_x = top_y;
+            panel_y = (LED_MATRIX_COLUMNS - 1) - x;
+#else
+            panel_x = x;
+            panel_y = top_y;
+#endif
+
+#if LED_MATRIX_WIRING == LED_MATRIX_WIRING_SERPENTINE
+            /* Every other row runs back */
+            if(0 != (panel_y & 1))
+            {
+                panel_x = (LED_MATRIX_WIDTH - 1) - panel_x;
+            }
+#endif
+
+            led_matrix_map[y][x] = (panel_y * LED_MATRIX_WIDTH) + panel_x;
+        }
+    }
+}
+
+/* LED index of the pixel, coordinates are not checked */
+uint16_t led_matrix_get_led(uint16_t x, uint16_t y)
+{
+    return led_matrix_map[y][x];
+}
+
+led_matrix_res_t led_matrix_set_pixel(uint16_t x, uint16_t y, uint8_t red, uint8_t green, uint8_t blue)
+{
+    if((x >= LED_MATRIX_COLUMNS) || (y >= LED_MATRIX_ROWS))
+    {
+        return led_matrix_error_invalid_pixel;
+    }
+
+    ws2812_set_led(led_matrix_map[y][x], red, green, blue);
+
+    return led_matrix_success;
+}
+
+/* Fills rectangle with (x, y) bottom left corner. Corner must be in the
+ * drawing area, parts of the rectangle that are out of it are clipped */
+led_matrix_res_t led_matrix_fill_rect(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t red,
+                                      uint8_t green, uint8_t blue)
+{
+    if((x >= LED_MATRIX_COLUMNS) || (y >= LED_MATRIX_ROWS))
+    {
+        return led_matrix_error_invalid_pixel;
+    }
+
+    uint16_t end_x = ((LED_MATRIX_COLUMNS - x) > width) ? (x + width) : LED_MATRIX_COLUMNS;
+    uint16_t end_y = ((LED_MATRIX_ROWS - y) > height) ? (y + height) : LED_MATRIX_ROWS;
+
+    for(uint16_t row = y; row < end_y; row++)
+    {
+        for(uint16_t column = x; column < end_x; column++)
+        {
+            ws2812_set_led(led_matrix_map[row][column], red, green, blue);
+        }
+    }
+
+    return led_matrix_success;
+}
+
+/* Sets LED_MATRIX_ROWS pixels of the column from the bottom one up */
+led_matrix_res_t led_matrix_set_column(uint16_t x, const led_color_t* colors)
+{
+    if(x >= LED_MATRIX_COLUMNS)
+    {
+        return led_matrix_error_invalid_pixel;
+    }
+
+    for(uint16_t y = 0; y < LED_MATRIX_ROWS; y++)
+    {
+        ws2812_set_led(led_matrix_map[y][x], colors[y].r, colors[y].g, colors[y].b);
+    }
+
+    return led_matrix_success;
+}
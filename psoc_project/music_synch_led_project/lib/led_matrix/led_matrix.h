@@ -0,0 +1,34 @@
+#ifndef __LED_MATRIX_H__
+#define __LED_MATRIX_H__
+
+#include "app_config.h"
+#include "ws2812.h"
+
+#if (LED_MATRIX_ROTATION != 0) && (LED_MATRIX_ROTATION != 90) && \
+    (LED_MATRIX_ROTATION != 180) && (LED_MATRIX_ROTATION != 270)
+#error "LED_MATRIX_ROTATION must be 0, 90, 180 or 270"
+#endif
+
+/* Size of the drawing area, it is turned on the panel by LED_MATRIX_ROTATION */
+#if (LED_MATRIX_ROTATION == 90) || (LED_MATRIX_ROTATION == 270)
+#define LED_MATRIX_COLUMNS  (LED_MATRIX_HEIGHT)
+#define LED_MATRIX_ROWS     (LED_MATRIX_WIDTH)
+#else
+#define LED_MATRIX_COLUMNS  (LED_MATRIX_WIDTH)
+#define LED_MATRIX_ROWS     (LED_MATRIX_HEIGHT)
+#endif
+
+typedef enum
+{
+    led_matrix_success,
+    led_matrix_error_invalid_pixel
+} led_matrix_res_t;
+
+void led_matrix_init(void);
+uint16_t led_matrix_get_led(uint16_t x, uint16_t y);
+led_matrix_res_t led_matrix_set_pixel(uint16_t x, uint16_t y, uint8_t red, uint8_t green, uint8_t blue);
+led_matrix_res_t led_matrix_fill_rect(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t red,
+                                      uint8_t green, uint8_t blue);
+led_matrix_res_t led_matrix_set_column(uint16_t x, const led_color_t* colors);
+
+#endif /* __LED_MATRIX_H__ */
@@ -0,0 +1,104 @@
+#include "sliding_dft.h"
+
+/* Samples are processed in chunks of this size */
+#define SLIDING_DFT_CHUNK_SIZE  (64)
+
+/* Every bin is damped a bit each sample, so float rounding errors
+ * fade out instead of accumulating forever */
+#define SLIDING_DFT_DAMPING     (0.99999f)
+
+/* Change of input of every bin, shared by all bins */
+static float sliding_dft_comb[SLIDING_DFT_CHUNK_SIZE];
+
+/* Tracks given DFT bins of the SLIDING_DFT_WINDOW_SIZE window.
+ * Power of the bins is in the same scale as of compute_rfft_split()
+ * float engine with FFT_SIZE, so the same thresholds can be used */
+sliding_dft_res_t sliding_dft_init(sliding_dft_t* sdft, const uint16_t* bins, size_t bins_count)
+{
+    if((0 == bins_count) || (bins_count > SLIDING_DFT_MAX_BINS))
+    {
+        return sliding_dft_error_invalid_bins;
+    }
+
+    for(size_t i = 0; i < bins_count; i++)
+    {
+        if(bins[i] >= (SLIDING_DFT_WINDOW_SIZE / 2))
+        {
+            return sliding_dft_error_invalid_bins;
+        }
+
+        float angle = (2 * PI * bins[i]) / SLIDING_DFT_WINDOW_SIZE;
+        sdft->twiddle_re[i] = SLIDING_DFT_DAMPING * cosf(angle);
+        sdft->twiddle_im[i] = SLIDING_DFT_DAMPING * sinf(angle);
+    }
+
+    sdft->bins_count = bins_count;
+    sdft->damping_n = powf(SLIDING_DFT_DAMPING, SLIDING_DFT_WINDOW_SIZE);
+    sliding_dft_reset(sdft);
+
+    return sliding_dft_success;
+}
+
+/* Starts over from silence, window is valid again after SLIDING_DFT_WINDOW_SIZE samples */
+void sliding_dft_reset(sliding_dft_t* sdft)
+{
+    for(size_t i = 0; i < sdft->bins_count; i++)
+    {
+        sdft->state_re[i] = 0;
+        sdft->state_im[i] = 0;
+    }
+
+    arm_fill_f32(0, sdft->delay, SLIDING_DFT_WINDOW_SIZE);
+    sdft->delay_index = 0;
+}
+
+/* Slides the window by length samples:
+ *      X(n) = r * e^(j*2*pi*k/N) * (X(n-1) + x(n) - r^N * x(n-N))
+ * Comb part is computed once per sample, then every bin is updated
+ * over the whole chunk so its state stays in registers */
+void sliding_dft_process(sliding_dft_t* sdft, const int16_t* samples, size_t length)
+{
+    while(0 != length)
+    {
+        size_t chunk = (length < SLIDING_DFT_CHUNK_SIZE) ? length : SLIDING_DFT_CHUNK_SIZE;
+
+        for(size_t i = 0; i < chunk; i++)
+        {
+            /* Samples are taken as Q31 the same way as by the float FFT engine */
+            float sample = (float)samples[i] * (1.0f / 2147483648.0f);
+            sliding_dft_comb[i] = sample - (sdft->damping_n * sdft->delay[sdft->delay_index]);
+            sdft->delay[sdft->delay_index] = sample;
+            sdft->delay_index = ((sdft->delay_index + 1) == SLIDING_DFT_WINDOW_SIZE) ? 0 : (sdft->delay_index + 1);
+        }
+
+        for(size_t k = 0; k < sdft->bins_count; k++)
+        {
+            float re = sdft->state_re[k];
+            float im = sdft->state_im[k];
+            const float twiddle_re = sdft->twiddle_re[k];
+            const float twiddle_im = sdft->twiddle_im[k];
+
+            for(size_t i = 0; i < chunk; i++)
+            {
+                float sum_re = re + sliding_dft_comb[i];
+                re = (sum_re * twiddle_re) - (im * twiddle_im);
+                im = (sum_re * twiddle_im) + (im * twiddle_re);
+            }
+
+            sdft->state_re[k] = re;
+            sdft->state_im[k] = im;
+        }
+
+        samples += chunk;
+        length -= chunk;
+    }
+}
+
+/* Power (squared magnitude) of every tracked bin */
+void sliding_dft_get_power(const sliding_dft_t* sdft, float* res)
+{
+    for(size_t k = 0; k < sdft->bins_count; k++)
+    {
+        res[k] = (sdft->state_re[k] * sdft->state_re[k]) + (sdft->state_im[k] * sdft->state_im[k]);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef __SLIDING_DFT_H__
+#define __SLIDING_DFT_H__
+
+#include "arm_math.h"
+#include "app_config.h"
+
+/* Maximum number of tracked bins */
+#define SLIDING_DFT_MAX_BINS    (3 * SLIDING_DFT_BINS_PER_BAND)
+
+/* Window of the sliding DFT, the same as of the FFT it replaces */
+#define SLIDING_DFT_WINDOW_SIZE (FFT_SIZE)
+
+typedef enum
+{
+    sliding_dft_success,
+    sliding_dft_error_invalid_bins
+} sliding_dft_res_t;
+
+typedef struct {
+    size_t bins_count;
+    /* Rotation of every bin per sample */
+    float twiddle_re[SLIDING_DFT_MAX_BINS];
+    float twiddle_im[SLIDING_DFT_MAX_BINS];
+    /* DFT of the latest window for every bin */
+    float state_re[SLIDING_DFT_MAX_BINS];
+    float state_im[SLIDING_DFT_MAX_BINS];
+    /* Damping of the sample that leaves the window */
+    float damping_n;
+    /* Latest SLIDING_DFT_WINDOW_SIZE samples, oldest one is at delay_index */
+    float delay[SLIDING_DFT_WINDOW_SIZE];
+    size_t delay_index;
+} sliding_dft_t;
+
+sliding_dft_res_t sliding_dft_init(sliding_dft_t* sdft, const uint16_t* bins, size_t bins_count);
+void sliding_dft_reset(sliding_dft_t* sdft);
+void sliding_dft_process(sliding_dft_t* sdft, const int16_t* samples, size_t length);
+void sliding_dft_get_power(const sliding_dft_t* sdft, float* res);
+
+#endif /* __SLIDING_DFT_H__ */
@@ -0,0 +1,124 @@
+#include "spectrum_bands.h"
+#include <math.h>
+
+static spectrum_bands_res_t spectrum_bands_finalize(spectrum_bands_t* bands, size_t bands_count, size_t bins_count);
+
+/* Builds log spaced bands between min_frequency and max_frequency.
+ * Should be called once at init, it is not fast */
+spectrum_bands_res_t spectrum_bands_init_log(spectrum_bands_t* bands, size_t bands_count, float min_frequency,
+                                             float max_frequency, float sample_rate, size_t fft_size)
+{
+    if((0 == bands_count) || (bands_count > SPECTRUM_BANDS_MAX) || (min_frequency <= 0) ||
+       (min_frequency >= max_frequency))
+    {
+        return spectrum_bands_error_invalid_bands;
+    }
+
+    float bin_width = sample_rate / fft_size;
+    float ratio = powf(max_frequency / min_frequency, 1.0f / bands_count);
+    float frequency = min_frequency;
+
+    for(size_t b = 0; b <= bands_count; b++)
+    {
+        bands->edges[b] = (uint16_t)lroundf(frequency / bin_width);
+        frequency *= ratio;
+    }
+
+    return spectrum_bands_finalize(bands, bands_count, fft_size / 2);
+}
+
+/* Builds bands from bands_count + 1 edge frequencies in Hz given in ascending order */
+spectrum_bands_res_t spectrum_bands_init_edges(spectrum_bands_t* bands, size_t bands_count, const float* edges_frequency,
+                                               float sample_rate, size_t fft_size)
+{
+    if((0 == bands_count) || (bands_count > SPECTRUM_BANDS_MAX))
+    {
+        return spectrum_bands_error_invalid_bands;
+    }
+
+    float bin_width = sample_rate / fft_size;
+    for(size_t b = 0; b <= bands_count; b++)
+    {
+        bands->edges[b] = (uint16_t)lroundf(edges_frequency[b] / bin_width);
+    }
+
+    return spectrum_bands_finalize(bands, bands_count, fft_size / 2);
+}
+
+/* Reduces power spectrum to the RMS magnitude of every band.
+ * Bands are adjacent so it is one linear pass over the used bins
+ * and sqrt() is done once per band */
+void spectrum_bands_compute(const spectrum_bands_t* bands, const float* fft_res, float* energies)
+{
+    size_t bin = bands->edges[0];
+    for(size_t b = 0; b < bands->bands_count; b++)
+    {
+        float sum = 0;
+        for(; bin < bands->edges[b + 1]; bin++)
+        {
+            sum += fft_res[bin];
+        }
+
+        energies[b] = sqrtf(sum * bands->scale[b]);
+    }
+}
+
+/* Makes sure that every band has at least one bin and all of them fit
+ * into the spectrum, then precomputes scale of every band */
+static spectrum_bands_res_t spectrum_bands_finalize(spectrum_bands_t* bands, size_t bands_count, size_t bins_count)
+{
+    /* Only bins 1 to bins_count - 1 can be used, every band needs one of them.
+     * Then bands pushed down below never reach DC bin */
+    if(bands_count >= bins_count)
+    {
+        return spectrum_bands_error_invalid_bands;
+    }
+
+    /* Bin 0 is DC so it is never used */
+    if(bands->edges[0] < 1)
+    {
+        bands->edges[0] = 1;
+    }
+    if(bands->edges[bands_count] > bins_count)
+    {
+        bands->edges[bands_count] = bins_count;
+    }
+
+    /* Narrow low bands are widened upwards */
+    for(size_t b = 1; b <= bands_count; b++)
+    {
+        if(bands->edges[b] <= bands->edges[b - 1])
+        {
+            bands->edges[b] = bands->edges[b - 1] + 1;
+        }
+    }
+
+    /* And pushed back down if top bands went out of spectrum */
+    if(bands->edges[bands_count] > bins_count)
+    {
+        bands->edges[bands_count] = bins_count;
+        for(size_t b = bands_count; b > 0; b--)
+        {
+            if(bands->edges[b - 1] >= bands->edges[b])
+            {
+                bands->edges[b - 1] = bands->edges[b] - 1;
+            }
+        }
+    }
+
+    for(size_t b = 0; b < bands_count; b++)
+    {
+        bands->scale[b] = 1.0f / (bands->edges[b + 1] - bands->edges[b]);
+    }
+
+    bands->bands_count = bands_count;
+
+    return spectrum_bands_success;
+}
+
+/* Range of bins used by the bands */
+void spectrum_bands_get_bins(const spectrum_bands_t* bands, size_t* first_bin, size_t* bins_count)
+{
+    *first_bin = bands->edges[0];
+    *bins_count = bands->edges[bands->bands_count] - bands->edges[0];
+}
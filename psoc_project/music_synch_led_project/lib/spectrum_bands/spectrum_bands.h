@@ -0,0 +1,32 @@
+#ifndef __SPECTRUM_BANDS_H__
+#define __SPECTRUM_BANDS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "app_config.h"
+
+/* Maximum number of bands, one band per LED */
+#define SPECTRUM_BANDS_MAX  (WS2812_LEDS_COUNT)
+
+typedef enum
+{
+    spectrum_bands_success,
+    spectrum_bands_error_invalid_bands
+} spectrum_bands_res_t;
+
+/* Band b covers FFT bins from edges[b] to edges[b + 1] - 1 */
+typedef struct {
+    size_t bands_count;
+    uint16_t edges[SPECTRUM_BANDS_MAX + 1];
+    /* 1 / (number of bins in the band), so mean does not need division */
+    float scale[SPECTRUM_BANDS_MAX];
+} spectrum_bands_t;
+
+spectrum_bands_res_t spectrum_bands_init_log(spectrum_bands_t* bands, size_t bands_count, float min_frequency,
+                                             float max_frequency, float sample_rate, size_t fft_size);
+spectrum_bands_res_t spectrum_bands_init_edges(spectrum_bands_t* bands, size_t bands_count, const float* edges_frequency,
+                                               float sample_rate, size_t fft_size);
+void spectrum_bands_compute(const spectrum_bands_t* bands, const float* fft_res, float* energies);
+void spectrum_bands_get_bins(const spectrum_bands_t* bands, size_t* first_bin, size_t* bins_count);
+
+#endif /* __SPECTRUM_BANDS_H__ */
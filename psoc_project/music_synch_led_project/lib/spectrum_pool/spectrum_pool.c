@@ -0,0 +1,141 @@
+#include "spectrum_pool.h"
+#include "cyhal.h"
+/* Free RTOS */
+#include "FreeRTOS.h"
+#include "queue.h"
+
+#if SPECTRUM_POOL_SLOTS < 2
+#error "SPECTRUM_POOL_SLOTS must be at least 2"
+#endif
+
+/* All slots are allocated statically, queues pass only pointers */
+static spectrum_slot_t spectrum_slots[SPECTRUM_POOL_SLOTS];
+
+/* Slots that can be filled by the producer */
+static QueueHandle_t free_queue = NULL;
+static StaticQueue_t free_queue_buffer;
+static uint8_t free_queue_storage[SPECTRUM_POOL_SLOTS * sizeof(spectrum_slot_t*)];
+
+/* Filled slots waiting for the consumer, oldest first */
+static QueueHandle_t ready_queue = NULL;
+static StaticQueue_t ready_queue_buffer;
+static uint8_t ready_queue_storage[SPECTRUM_POOL_SLOTS * sizeof(spectrum_slot_t*)];
+
+/* Number of filled slots that were reused before the consumer got them */
+static volatile uint32_t drops = 0;
+
+/* Largest number of slots that were waiting for the consumer */
+static volatile uint32_t ready_depth_max = 0;
+
+static void spectrum_pool_count_drop(void);
+
+spectrum_pool_res_t spectrum_pool_init(void)
+{
+    free_queue = xQueueCreateStatic(SPECTRUM_POOL_SLOTS, sizeof(spectrum_slot_t*), free_queue_storage, &free_queue_buffer);
+    if(NULL == free_queue)
+    {
+        return spectrum_pool_error_generic;
+    }
+
+    ready_queue = xQueueCreateStatic(SPECTRUM_POOL_SLOTS, sizeof(spectrum_slot_t*), ready_queue_storage, &ready_queue_buffer);
+    if(NULL == ready_queue)
+    {
+        return spectrum_pool_error_generic;
+    }
+
+    for(size_t i = 0; i < SPECTRUM_POOL_SLOTS; i++)
+    {
+        spectrum_slot_t* slot = &spectrum_slots[i];
+        xQueueSend(free_queue, &slot, 0);
+    }
+
+    return spectrum_pool_success;
+}
+
+/* Gives a slot to fill. Producer never waits for the consumer:
+ * if all slots are taken the oldest queued spectrum is dropped,
+ * so the latest audio is always rendered */
+spectrum_slot_t* spectrum_pool_acquire(void)
+{
+    spectrum_slot_t* slot;
+
+    if(pdTRUE == xQueueReceive(free_queue, &slot, 0))
+    {
+        return slot;
+    }
+
+    if(pdTRUE == xQueueReceive(ready_queue, &slot, 0))
+    {
+        spectrum_pool_count_drop();
+        return slot;
+    }
+
+    /* Consumer holds the rest of slots, wait for one of them */
+    xQueueReceive(free_queue, &slot, portMAX_DELAY);
+    return slot;
+}
+
+/* Passes filled slot to the consumer */
+void spectrum_pool_submit(spectrum_slot_t* slot)
+{
+    xQueueSend(ready_queue, &slot, portMAX_DELAY);
+
+    uint32_t ready_depth = uxQueueMessagesWaiting(ready_queue);
+    if(ready_depth > ready_depth_max)
+    {
+        ready_depth_max = ready_depth;
+    }
+}
+
+/* Waits for the oldest filled slot */
+spectrum_slot_t* spectrum_pool_receive(void)
+{
+    spectrum_slot_t* slot;
+
+    xQueueReceive(ready_queue, &slot, portMAX_DELAY);
+
+    return slot;
+}
+
+/* Takes the newest filled slot without waiting, older ones are dropped.
+ * Returns NULL if nothing was submitted since the previous call */
+spectrum_slot_t* spectrum_pool_receive_latest(void)
+{
+    spectrum_slot_t* slot = NULL;
+    spectrum_slot_t* newer;
+
+    while(pdTRUE == xQueueReceive(ready_queue, &newer, 0))
+    {
+        if(NULL != slot)
+        {
+            spectrum_pool_release(slot);
+            spectrum_pool_count_drop();
+        }
+        slot = newer;
+    }
+
+    return slot;
+}
+
+/* Returns slot to the producer once it is no longer needed */
+void spectrum_pool_release(spectrum_slot_t* slot)
+{
+    xQueueSend(free_queue, &slot, portMAX_DELAY);
+}
+
+void spectrum_pool_get_stats(spectrum_pool_stats_t* stats)
+{
+    stats->ready_depth = uxQueueMessagesWaiting(ready_queue);
+    stats->ready_depth_max = ready_depth_max;
+    stats->free_depth = uxQueueMessagesWaiting(free_queue);
+    stats->drops = drops;
+}
+
+/* Producer and consumer tasks both drop slots, so the
+ * read-modify-write of the counter must not be interrupted */
+static void spectrum_pool_count_drop(void)
+{
+    uint32_t critical_section = cyhal_system_critical_section_enter();
+    drops++;
+    cyhal_system_critical_section_exit(critical_section);
+}
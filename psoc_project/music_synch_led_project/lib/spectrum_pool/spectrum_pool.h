@@ -0,0 +1,49 @@
+#ifndef __SPECTRUM_POOL_H__
+#define __SPECTRUM_POOL_H__
+
+#include "app_config.h"
+#include "audio_visualizer.h"
+
+typedef enum
+{
+    spectrum_pool_success,
+    spectrum_pool_error_generic
+} spectrum_pool_res_t;
+
+/* FFT result will have length of half of the FFT size, but fft wrapper
+ * internally uses result buffer for temporary conversions/results
+ * so result buffer must have the size of the largest input */
+typedef struct {
+    float fft_res[FFT_MAX_SIZE];
+#if BASS_ANALYSIS == 1
+    /* Power spectrum of decimated audio */
+    float bass_res[BASS_FFT_SIZE];
+#endif
+    /* Number of valid power values in fft_res, half of the FFT size it was computed with */
+    size_t spectrum_size;
+    /* Beat state, valid for modes that need VISUALIZE_NEEDS_BEAT */
+    beat_info_t beat;
+    visualization_mode_t mode;
+    uint16_t frame;
+#if MEASURE_LATENCY == 1
+    /* Capture timestamp of the newest audio block the spectrum was computed from */
+    uint32_t capture_timestamp;
+#endif
+} spectrum_slot_t;
+
+typedef struct {
+    uint32_t ready_depth;
+    uint32_t ready_depth_max;
+    uint32_t free_depth;
+    uint32_t drops;
+} spectrum_pool_stats_t;
+
+spectrum_pool_res_t spectrum_pool_init(void);
+spectrum_slot_t* spectrum_pool_acquire(void);
+void spectrum_pool_submit(spectrum_slot_t* slot);
+spectrum_slot_t* spectrum_pool_receive(void);
+spectrum_slot_t* spectrum_pool_receive_latest(void);
+void spectrum_pool_release(spectrum_slot_t* slot);
+void spectrum_pool_get_stats(spectrum_pool_stats_t* stats);
+
+#endif /* __SPECTRUM_POOL_H__ */
@@ -0,0 +1,133 @@
+#include "trace.h"
+
+#if (TRACE_BUFFER_EVENTS & (TRACE_BUFFER_EVENTS - 1)) != 0
+#error "TRACE_BUFFER_EVENTS must be a power of 2"
+#endif
+
+#define TRACE_INDEX_MASK    (TRACE_BUFFER_EVENTS - 1)
+
+/* Event is valid when its sequence equals its index + 1,
+ * sequence is written last so reader never sees half written event */
+typedef struct {
+    trace_event_t event;
+    volatile uint32_t sequence;
+} trace_slot_t;
+
+static trace_slot_t trace_ring[TRACE_BUFFER_EVENTS];
+
+/* Index of the next event to be written, producers reserve
+ * slots with exclusive access so no locks are needed */
+static volatile uint32_t trace_write_index = 0;
+
+/* Index of the next event to be read, used only by the reader */
+static uint32_t trace_read_index = 0;
+
+/* Number of events overwritten before they were read */
+static uint32_t trace_dropped = 0;
+
+/* Free running timer, the same one is used for FreeRTOS run time stats */
+static cyhal_timer_t* trace_timer_obj = NULL;
+
+trace_res_t trace_init(cyhal_timer_t* timer_obj)
+{
+    cy_rslt_t cy_res;
+
+    /* Timer is never reset after this point */
+    cyhal_timer_stop(timer_obj);
+
+    cy_res = cyhal_timer_reset(timer_obj);
+    if(CY_RSLT_SUCCESS != cy_res)
+    {
+        return trace_error_generic;
+    }
+
+    cy_res = cyhal_timer_start(timer_obj);
+    if(CY_RSLT_SUCCESS != cy_res)
+    {
+        return trace_error_generic;
+    }
+
+    trace_timer_obj = timer_obj;
+
+    return trace_success;
+}
+
+uint32_t trace_get_timestamp(void)
+{
+    if(NULL == trace_timer_obj)
+    {
+        return 0;
+    }
+
+    return cyhal_timer_read(trace_timer_obj);
+}
+
+/* Appends event to the ring. Can be called from tasks and ISRs,
+ * never blocks. When ring is full the oldest event is overwritten */
+void trace_event(trace_id_t id, uint16_t arg)
+{
+    uint32_t index;
+
+    /* Reserve a slot, retried if an interrupt reserved one in between */
+    do
+    {
+        index = __LDREXW(&trace_write_index);
+    } while(0u != __STREXW(index + 1u, &trace_write_index));
+
+    trace_slot_t* slot = &trace_ring[index & TRACE_INDEX_MASK];
+    slot->event.timestamp = trace_get_timestamp();
+    slot->event.id = id;
+    slot->event.arg = arg;
+
+    __DMB();
+    slot->sequence = index + 1u;
+}
+
+/* Copies up to max_events events in the order they were reserved.
+ * Only one reader is supported. Reading stops at the first event
+ * that is still being written, it is returned by the next call */
+size_t trace_read(trace_event_t* events, size_t max_events)
+{
+    size_t count = 0;
+
+    while(count < max_events)
+    {
+        trace_slot_t* slot = &trace_ring[trace_read_index & TRACE_INDEX_MASK];
+        int32_t lag = (int32_t)(slot->sequence - (trace_read_index + 1u));
+
+        if(lag < 0)
+        {
+            /* Not written yet */
+            break;
+        }
+
+        if(lag > 0)
+        {
+            /* Writers went around the ring, skip to the oldest event that is left */
+            uint32_t oldest = trace_write_index - TRACE_BUFFER_EVENTS;
+            trace_dropped += oldest - trace_read_index;
+            trace_read_index = oldest;
+            continue;
+        }
+
+        __DMB();
+        events[count] = slot->event;
+        __DMB();
+
+        /* Event could be overwritten while it was copied */
+        if(slot->sequence != (trace_read_index + 1u))
+        {
+            continue;
+        }
+
+        trace_read_index++;
+        count++;
+    }
+
+    return count;
+}
+
+uint32_t trace_get_dropped(void)
+{
+    return trace_dropped;
+}
@@ -0,0 +1,41 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include "app_config.h"
+#include "cyhal.h"
+
+typedef enum
+{
+    trace_success,
+    trace_error_generic
+} trace_res_t;
+
+/* Points of the pipeline that are traced */
+typedef enum
+{
+    TRACE_ID_FRAME_START,
+    TRACE_ID_CAPTURE_DONE,
+    TRACE_ID_FFT_DONE,
+    TRACE_ID_RENDER_START,
+    TRACE_ID_VISUALIZATION_DONE,
+    TRACE_ID_AUDIO_BLOCK,
+    TRACE_ID_AUDIO_OVERRUN,
+    TRACE_ID_LEDS_TRANSFER_START,
+    TRACE_ID_LEDS_TRANSFER_DONE,
+    TRACE_ID_LEDS_UNDERRUN,
+    TRACE_ID_MAX
+} trace_id_t;
+
+typedef struct {
+    uint32_t timestamp;
+    uint16_t id;
+    uint16_t arg;
+} trace_event_t;
+
+trace_res_t trace_init(cyhal_timer_t* timer_obj);
+uint32_t trace_get_timestamp(void);
+void trace_event(trace_id_t id, uint16_t arg);
+size_t trace_read(trace_event_t* events, size_t max_events);
+uint32_t trace_get_dropped(void);
+
+#endif /* __TRACE_H__ */
@@ -1,43 +1,192 @@
 #include "ws2812.h"
+#include <stdio.h>
+#include <math.h>
+/* Free RTOS */
+#include "FreeRTOS.h"
+#include "semphr.h"
+#if (MEASURE_PERFORMANCE == 1) || (MEASURE_LATENCY == 1)
+#include "trace.h"
+#endif
+#if MEASURE_LATENCY == 1
+#include "latency.h"
+#endif
 
 #define WS_ZERO_OFFSET      (1)
 #define WS_ONE_CODE         (0b110 << 24)
 #define WS_ZERO_CODE        (0b100 << 24)
 #define WS_SPI_BIT_PER_BIT  (3)
 #define WS_COLOR_PER_PIXEL  (3)
-#define WS_BYTES_PER_PIXEL  (WS_SPI_BIT_PER_BIT * WS_COLOR_PER_PIXEL)
+#define WS_ENCODED_PIXEL_SIZE   (WS_SPI_BIT_PER_BIT * WS_COLOR_PER_PIXEL)
+#if WS2812_STREAMING_ENCODER == 1
+/* Frame keeps colours in GRB order, zero byte is added to the first chunk */
+#define WS_BYTES_PER_PIXEL  (WS_COLOR_PER_PIXEL)
+#define WS_PIXELS_OFFSET    (0)
+#else
+#define WS_BYTES_PER_PIXEL  (WS_ENCODED_PIXEL_SIZE)
+#define WS_PIXELS_OFFSET    (WS_ZERO_OFFSET)
+#define WS_FRAME_BUFFERS    (2)
+#endif
+#define WS_STRIP_FRAME_SIZE (WS_PIXELS_OFFSET + (WS2812_STRIP_LEDS * WS_BYTES_PER_PIXEL))
+#define WS_FRAME_SIZE       (WS2812_STRIPS_COUNT * WS_STRIP_FRAME_SIZE)
+#define WS_STREAM_CHUNK_SIZE    (WS_ZERO_OFFSET + (WS2812_STREAM_CHUNK_LEDS * WS_ENCODED_PIXEL_SIZE))
+#define WS_STREAM_CHUNKS    (2)
+#define WS_SPI_FREQUENCY    (2200000)
 
-static uint8_t ws_frame_buffer[WS_ZERO_OFFSET + (WS2812_LEDS_COUNT * WS_BYTES_PER_PIXEL)];
-static cyhal_spi_t ws2182_spi_handle;
-static uint32_t ws_convert_3_code(uint8_t input);
+#if WS_BYTES_PER_PIXEL != WS2812_BYTES_PER_PIXEL
+#error "WS2812_BYTES_PER_PIXEL doesn't match the frame format"
+#endif
 
-typedef union
-{
-    uint8_t bytes[4];
-    uint32_t word;
-} ws_converted_color_u;
+/* Colour levels after gamma and brightness have 8 fractional bits */
+#define WS_LEVEL_SHIFT      (8)
+#define WS_LEVEL_MAX        (255)
+#define WS_DITHER_STEPS     (8)
+
+/* Fraction that rounds levels to the nearest one */
+#define WS_ROUNDING         (1 << (WS_LEVEL_SHIFT - 1))
+
+/* Number of LEDs encoded by the benchmark */
+#define WS_BENCHMARK_LEDS   (WS2812_LEDS_COUNT)
+
+/* Compile time version of ws_convert_3_code() used to build the lookup table.
+ * Every bit of the colour is expanded to 3 SPI bits (1 -> 110, 0 -> 100),
+ * MSB ends up in the highest bits of the 24-bit code */
+#define WS_CODE_BIT(v, n)   (((((v) >> (n)) & 1u) ? 0b110u : 0b100u) << (WS_SPI_BIT_PER_BIT * (n)))
+#define WS_CODE(v)          (WS_CODE_BIT(v, 7) | WS_CODE_BIT(v, 6) | WS_CODE_BIT(v, 5) | WS_CODE_BIT(v, 4) | \
+                             WS_CODE_BIT(v, 3) | WS_CODE_BIT(v, 2) | WS_CODE_BIT(v, 1) | WS_CODE_BIT(v, 0))
+#define WS_CODE_4(v)        WS_CODE((v) + 0), WS_CODE((v) + 1), WS_CODE((v) + 2), WS_CODE((v) + 3)
+#define WS_CODE_16(v)       WS_CODE_4((v) + 0), WS_CODE_4((v) + 4), WS_CODE_4((v) + 8), WS_CODE_4((v) + 12)
+#define WS_CODE_64(v)       WS_CODE_16((v) + 0), WS_CODE_16((v) + 16), WS_CODE_16((v) + 32), WS_CODE_16((v) + 48)
+
+/* Precomputed WS2812 codes for every possible colour value.
+ * Only lower 3 bytes of each entry are used */
+static const uint32_t ws_code_table[256] = {
+    WS_CODE_64(0), WS_CODE_64(64), WS_CODE_64(128), WS_CODE_64(192)
+};
+
+/* Colour value to gamma corrected and scaled level in 8.8 fixed point,
+ * built by ws2812_set_brightness() */
+static uint16_t ws_level_table[256];
+
+#if WS2812_DITHERING == 1
+/* Fractions added to levels before truncation, bit reversed order
+ * so that every run of frames is spread evenly */
+static const uint8_t ws_dither_table[WS_DITHER_STEPS] = {
+    16, 144, 80, 208, 48, 176, 112, 240
+};
+
+/* Moves dither pattern by one step every frame */
+static uint8_t ws_dither_frame = 0;
+#endif
+
+#if WS2812_STREAMING_ENCODER == 1
+/* SPI data of one strip is encoded from the frame chunk by chunk.
+ * While one chunk is transferred by DMA the other one is filled */
+typedef struct {
+    uint8_t chunks[WS_STREAM_CHUNKS][WS_STREAM_CHUNK_SIZE];
+    size_t chunk_length[WS_STREAM_CHUNKS];
+    uint16_t next_led;
+    uint16_t end_led;
+    uint8_t sending;
+} ws_stream_t;
+
+/* Colours of all LEDs, one segment per strip. It is read
+ * by SPI IRQ until the frame is sent */
+static uint8_t ws_frame_buffer[WS_FRAME_SIZE];
+static ws_stream_t ws_streams[WS2812_STRIPS_COUNT];
+static volatile uint32_t ws_underruns = 0;
+#else
+/* While one buffer is transferred to the LEDs by DMA (front buffer)
+ * other one is filled with the next frame (back buffer).
+ * Each buffer holds one segment per strip: zero byte followed by strip LEDs */
+static uint8_t ws_frame_buffers[WS_FRAME_BUFFERS][WS_FRAME_SIZE];
+static uint8_t* ws_frame_buffer = ws_frame_buffers[0];
+static uint8_t* ws_front_buffer = ws_frame_buffers[1];
+#endif
+static cyhal_spi_t ws_spi_handles[WS2812_STRIPS_COUNT];
+
+/* Semaphore is available when SPI is not transferring any frame.
+ * It is taken when transfer starts and given back from SPI IRQ
+ * of the strip which finishes last */
+static SemaphoreHandle_t ws_idle_semaphore = NULL;
+static StaticSemaphore_t ws_idle_semaphore_buffer;
+static volatile uint32_t ws_pending_strips = 0;
+static volatile bool ws_transfer_active = false;
+
+#if MEASURE_LATENCY == 1
+/* Capture timestamps of the audio the drawn frame and the frame
+ * being sent were computed from, frames without one are not measured */
+static uint32_t ws_frame_timestamp;
+static bool ws_frame_timestamp_valid = false;
+static uint32_t ws_front_timestamp;
+static bool ws_front_timestamp_valid = false;
+#endif
 
-ws2818_res_t ws2812_init(cyhal_gpio_t mosi, cyhal_gpio_t miso, cyhal_gpio_t sclk)
+static void ws_spi_event_handler(void* arg, cyhal_spi_event_t event);
+static inline uint8_t* ws_led_address(uint8_t* buffer, uint16_t led);
+static void ws_copy_pixels(uint16_t first, const uint8_t* pixels, uint16_t count);
+static inline void ws_encode_codes(uint8_t* dst, uint32_t green_code, uint32_t red_code, uint32_t blue_code);
+static inline void ws_encode_pixel(uint8_t* dst, uint8_t red, uint8_t green, uint8_t blue);
+static inline void ws_encode_color(uint8_t* dst, uint8_t red, uint8_t green, uint8_t blue, uint8_t dither);
+static inline uint8_t ws_dither(uint16_t led);
+static inline void ws_store_pixel(uint8_t* dst, uint8_t red, uint8_t green, uint8_t blue, uint8_t dither);
+static inline void ws_wait_frame_buffer(void);
+#if WS2812_STREAMING_ENCODER == 1
+static void ws_stream_fill(ws_stream_t* stream, uint8_t chunk, size_t offset);
+#endif
+#if MEASURE_PERFORMANCE == 1
+static void ws_encode_pixel_per_bit(uint8_t* dst, uint8_t red, uint8_t green, uint8_t blue);
+static uint32_t ws_convert_3_code(uint8_t input);
+#endif
+
+ws2818_res_t ws2812_init(const cyhal_gpio_t* mosi_pins)
 {
     cy_rslt_t cy_res;
     ws2818_res_t ws_res;
 
-    /* Initialize SPI block that will be used to drive data to the LEDs */
-    cy_res = cyhal_spi_init(&ws2182_spi_handle, mosi, miso, sclk, NC, NULL, 8, CYHAL_SPI_MODE_11_MSB, false);
-    if(CY_RSLT_SUCCESS != cy_res)
-    {
-        return ws2812_error_generic;
-    }
+    /* Create semaphore, SPI is idle at this point */
+    ws_idle_semaphore = xSemaphoreCreateBinaryStatic(&ws_idle_semaphore_buffer);
+    xSemaphoreGive(ws_idle_semaphore);
+
+    ws2812_set_brightness(WS2812_BRIGHTNESS);
 
-    cy_res = cyhal_spi_set_frequency(&ws2182_spi_handle, 2200000);
-    if(CY_RSLT_SUCCESS != cy_res)
+    for(size_t strip = 0; strip < WS2812_STRIPS_COUNT; strip++)
     {
-        return ws2812_error_generic;
-    }
+        cyhal_spi_t* spi = &ws_spi_handles[strip];
+
+        /* Initialize SPI block that will be used to drive data to the strip.
+         * MISO and SCLK are not needed so they are not connected (NC) */
+        cy_res = cyhal_spi_init(spi, mosi_pins[strip], NC, NC, NC, NULL, 8, CYHAL_SPI_MODE_11_MSB, false);
+        if(CY_RSLT_SUCCESS != cy_res)
+        {
+            return ws2812_error_generic;
+        }
+
+        cy_res = cyhal_spi_set_frequency(spi, WS_SPI_FREQUENCY);
+        if(CY_RSLT_SUCCESS != cy_res)
+        {
+            return ws2812_error_generic;
+        }
 
-    /* First byte of transferred data is ignored by WS2812 for some reasons,
-     * so it makes sense to zero it out */
-    ws_frame_buffer[0] = 0x00;
+        /* Use DMA so CPU is free while frame is being transferred */
+        cy_res = cyhal_spi_set_async_mode(spi, CYHAL_ASYNC_DMA, CYHAL_DMA_PRIORITY_DEFAULT);
+        if(CY_RSLT_SUCCESS != cy_res)
+        {
+            return ws2812_error_generic;
+        }
+
+        /* Subscribe to the transfer complete event */
+        cyhal_spi_register_callback(spi, &ws_spi_event_handler, (void*)strip);
+        cyhal_spi_enable_event(spi, CYHAL_SPI_IRQ_DONE, CYHAL_ISR_PRIORITY_DEFAULT, true);
+
+#if WS2812_STREAMING_ENCODER == 0
+        /* First byte of transferred data is ignored by WS2812 for some reasons,
+         * so it makes sense to zero it out */
+        for(size_t i = 0; i < WS_FRAME_BUFFERS; i++)
+        {
+            ws_frame_buffers[i][strip * WS_STRIP_FRAME_SIZE] = 0x00;
+        }
+#endif
+    }
 
     /* Turn of all LEDs */
     ws_res =  ws2812_set_all_leds(0, 0, 0);
@@ -62,23 +211,41 @@ ws2818_res_t ws2812_set_led(uint16_t led, uint8_t red, uint8_t green, uint8_t bl
         return ws2812_error_invalid_led_id;
     }
 
-    ws_converted_color_u color;
+    ws_wait_frame_buffer();
+    ws_store_pixel(ws_led_address(ws_frame_buffer, led), red, green, blue, ws_dither(led));
 
-    /* WS2812 expects green then red then blue colours for the LED */
-    color.word = ws_convert_3_code(green);
-    ws_frame_buffer[WS_ZERO_OFFSET + (led * WS_BYTES_PER_PIXEL) + 0] = color.bytes[2];
-    ws_frame_buffer[WS_ZERO_OFFSET + (led * WS_BYTES_PER_PIXEL) + 1] = color.bytes[1];
-    ws_frame_buffer[WS_ZERO_OFFSET + (led * WS_BYTES_PER_PIXEL) + 2] = color.bytes[0];
+    return ws2812_success;
+}
 
-    color.word = ws_convert_3_code(red);
-    ws_frame_buffer[WS_ZERO_OFFSET + (led * WS_BYTES_PER_PIXEL) + 3] = color.bytes[2];
-    ws_frame_buffer[WS_ZERO_OFFSET + (led * WS_BYTES_PER_PIXEL) + 4] = color.bytes[1];
-    ws_frame_buffer[WS_ZERO_OFFSET + (led * WS_BYTES_PER_PIXEL) + 5] = color.bytes[0];
+ws2818_res_t ws2812_set_leds(const led_color_t* colors, uint16_t first, uint16_t count)
+{
+    if((first + count) > WS2812_LEDS_COUNT)
+    {
+        return ws2812_error_invalid_led_id;
+    }
+
+    ws_wait_frame_buffer();
+
+    /* Pixels are encoded strip by strip, within a strip they are contiguous */
+    while(count > 0)
+    {
+        uint16_t chunk = WS2812_STRIP_LEDS - (first % WS2812_STRIP_LEDS);
+        if(chunk > count)
+        {
+            chunk = count;
+        }
+
+        uint8_t* dst = ws_led_address(ws_frame_buffer, first);
+        for(size_t i = 0; i < chunk; i++)
+        {
+            ws_store_pixel(dst, colors[i].r, colors[i].g, colors[i].b, ws_dither(first + i));
+            dst += WS_BYTES_PER_PIXEL;
+        }
 
-    color.word = ws_convert_3_code(blue);
-    ws_frame_buffer[WS_ZERO_OFFSET + (led * WS_BYTES_PER_PIXEL) + 6] = color.bytes[2];
-    ws_frame_buffer[WS_ZERO_OFFSET + (led * WS_BYTES_PER_PIXEL) + 7] = color.bytes[1];
-    ws_frame_buffer[WS_ZERO_OFFSET + (led * WS_BYTES_PER_PIXEL) + 8] = color.bytes[0];
+        colors += chunk;
+        first += chunk;
+        count -= chunk;
+    }
 
     return ws2812_success;
 }
@@ -86,7 +253,6 @@ ws2818_res_t ws2812_set_led(uint16_t led, uint8_t red, uint8_t green, uint8_t bl
 ws2818_res_t ws2812_set_range(uint16_t start, uint16_t end, uint8_t red, uint8_t green, uint8_t blue)
 {
     ws2818_res_t ws_res;
-    size_t length = end - start;
 
     if((start > end) || (end > (WS2812_LEDS_COUNT - 1)))
     {
@@ -100,11 +266,10 @@ ws2818_res_t ws2812_set_range(uint16_t start, uint16_t end, uint8_t red, uint8_t
         return ws_res;
     }
 
-    for(size_t i = 1; i <= length; i++)
+    const uint8_t* pixel = ws_led_address(ws_frame_buffer, start);
+    for(uint16_t led = start + 1; led <= end; led++)
     {
-        memcpy(&ws_frame_buffer[(start * WS_BYTES_PER_PIXEL) + (i * WS_BYTES_PER_PIXEL) + WS_ZERO_OFFSET],
-               &ws_frame_buffer[(start * WS_BYTES_PER_PIXEL) + WS_ZERO_OFFSET],
-               WS_BYTES_PER_PIXEL);
+        memcpy(ws_led_address(ws_frame_buffer, led), pixel, WS_BYTES_PER_PIXEL);
     }
 
     return ws2812_success;
@@ -115,20 +280,491 @@ ws2818_res_t ws2812_set_all_leds(uint8_t red, uint8_t green, uint8_t blue)
     return ws2812_set_range(0, WS2812_LEDS_COUNT - 1, red, green, blue);
 }
 
-/* Send the latest frame buffer to the LEDs */
+/* Fills the ring with turned off LEDs. pixels must have
+ * WS2812_RING_SIZE(length) bytes and live as long as the ring */
+ws2818_res_t ws2812_ring_init(ws2812_ring_t* ring, uint8_t* pixels, uint16_t length, ws2812_ring_order_t order)
+{
+    if(NULL == pixels)
+    {
+        return ws2812_error_generic;
+    }
+
+    if((0 == length) || (length > WS2812_LEDS_COUNT))
+    {
+        return ws2812_error_invalid_led_id;
+    }
+
+    ring->pixels = pixels;
+    ring->length = length;
+    ring->head = 0;
+    ring->order = order;
+
+    ws_store_pixel(&ring->pixels[0], 0, 0, 0, WS_ROUNDING);
+    for(size_t i = 1; i < length; i++)
+    {
+        memcpy(&ring->pixels[i * WS_BYTES_PER_PIXEL], &ring->pixels[0], WS_BYTES_PER_PIXEL);
+    }
+
+    return ws2812_success;
+}
+
+/* Encodes new pixel in place of the oldest one.
+ * Head always points to the first pixel to be sent, for newest first
+ * order that is the new pixel, otherwise it is the oldest one.
+ * Encoded pixel moves to other LEDs in the next frames, so it is
+ * rounded instead of dithered. Streaming encoder dithers it when sent */
+void ws2812_ring_push(ws2812_ring_t* ring, uint8_t red, uint8_t green, uint8_t blue)
+{
+    if(ws2812_ring_newest_first == ring->order)
+    {
+        ring->head = (0 == ring->head) ? (ring->length - 1) : (ring->head - 1);
+        ws_store_pixel(&ring->pixels[ring->head * WS_BYTES_PER_PIXEL], red, green, blue, WS_ROUNDING);
+    }
+    else
+    {
+        ws_store_pixel(&ring->pixels[ring->head * WS_BYTES_PER_PIXEL], red, green, blue, WS_ROUNDING);
+        ring->head = ((ring->head + 1) == ring->length) ? 0 : (ring->head + 1);
+    }
+}
+
+/* Writes ring pixels to LEDs starting from first, it takes
+ * two copies per strip at most and no encoding */
+ws2818_res_t ws2812_set_ring(const ws2812_ring_t* ring, uint16_t first)
+{
+    if((first + ring->length) > WS2812_LEDS_COUNT)
+    {
+        return ws2812_error_invalid_led_id;
+    }
+
+    ws_wait_frame_buffer();
+    ws_copy_pixels(first, &ring->pixels[ring->head * WS_BYTES_PER_PIXEL], ring->length - ring->head);
+    ws_copy_pixels(first + ring->length - ring->head, ring->pixels, ring->head);
+
+    return ws2812_success;
+}
+
+/* Send the latest frame buffer to the LEDs.
+ * Transfer is done in background, all strips are sent in parallel
+ * and function only waits for the previous frame to be sent */
 ws2818_res_t ws2812_update(void)
 {
     cy_rslt_t cy_res;
 
-    /* TODO: This may be asynch transfer using Semaphores */
-    cy_res = cyhal_spi_transfer(&ws2182_spi_handle, ws_frame_buffer, WS_ZERO_OFFSET + (WS2812_LEDS_COUNT * WS_BYTES_PER_PIXEL), NULL, 0, 0x00);
-    if(CY_RSLT_SUCCESS != cy_res)
+    /* Wait for the front buffer to be released */
+    xSemaphoreTake(ws_idle_semaphore, portMAX_DELAY);
+    ws_transfer_active = true;
+
+#if WS2812_DITHERING == 1
+    ws_dither_frame++;
+#endif
+
+#if WS2812_STREAMING_ENCODER == 1
+    /* Encode first two chunks of every strip, the rest is encoded from SPI IRQ */
+    for(size_t strip = 0; strip < WS2812_STRIPS_COUNT; strip++)
     {
-        return ws2812_error_generic;
+        ws_stream_t* stream = &ws_streams[strip];
+
+        stream->next_led = strip * WS2812_STRIP_LEDS;
+        stream->end_led = stream->next_led + WS2812_STRIP_LEDS;
+        stream->sending = 0;
+
+        /* First byte of transferred data is ignored by WS2812 for some reasons,
+         * so it makes sense to zero it out */
+        stream->chunks[0][0] = 0x00;
+        ws_stream_fill(stream, 0, WS_ZERO_OFFSET);
+        ws_stream_fill(stream, 1, 0);
+    }
+#else
+    /* Swap buffers */
+    uint8_t* swap_tmp = ws_front_buffer;
+    ws_front_buffer = ws_frame_buffer;
+    ws_frame_buffer = swap_tmp;
+#endif
+
+#if MEASURE_LATENCY == 1
+    ws_front_timestamp = ws_frame_timestamp;
+    ws_front_timestamp_valid = ws_frame_timestamp_valid;
+    ws_frame_timestamp_valid = false;
+#endif
+
+#if MEASURE_PERFORMANCE == 1
+    trace_event(TRACE_ID_LEDS_TRANSFER_START, 0);
+#endif
+
+    /* Start all strips back to back, the last one to complete releases the buffer */
+    ws_pending_strips = WS2812_STRIPS_COUNT;
+    for(size_t strip = 0; strip < WS2812_STRIPS_COUNT; strip++)
+    {
+#if WS2812_STREAMING_ENCODER == 1
+        cy_res = cyhal_spi_transfer_async(&ws_spi_handles[strip], ws_streams[strip].chunks[0],
+                                          ws_streams[strip].chunk_length[0], NULL, 0);
+#else
+        cy_res = cyhal_spi_transfer_async(&ws_spi_handles[strip], &ws_front_buffer[strip * WS_STRIP_FRAME_SIZE],
+                                          WS_STRIP_FRAME_SIZE, NULL, 0);
+#endif
+        if(CY_RSLT_SUCCESS != cy_res)
+        {
+            /* Strips that were not started will never complete, account for them */
+            uint32_t critical_section = cyhal_system_critical_section_enter();
+            ws_pending_strips -= WS2812_STRIPS_COUNT - strip;
+            bool idle = (0 == ws_pending_strips);
+            cyhal_system_critical_section_exit(critical_section);
+            if(idle)
+            {
+                ws_transfer_active = false;
+                xSemaphoreGive(ws_idle_semaphore);
+            }
+            return ws2812_error_generic;
+        }
+    }
+
+#if WS2812_STREAMING_ENCODER == 0
+    /* Callers expect that LEDs which were not set keep their
+     * previous value, so the new back buffer starts as a copy
+     * of the frame that is being sent */
+    memcpy(ws_frame_buffer, ws_front_buffer, WS_FRAME_SIZE);
+#endif
+
+    return ws2812_success;
+}
+
+/* Blocks until the last frame is sent to the LEDs */
+void ws2812_wait_idle(void)
+{
+    xSemaphoreTake(ws_idle_semaphore, portMAX_DELAY);
+    xSemaphoreGive(ws_idle_semaphore);
+}
+
+/* Builds the table which applies gamma and master brightness while
+ * LEDs are encoded. Without streaming encoder it affects only LEDs
+ * set after the call, already encoded ones keep previous brightness.
+ * Streaming encoder reads the table from SPI IRQ, so the frame
+ * being sent is finished before the table is rebuilt */
+void ws2812_set_brightness(uint8_t brightness)
+{
+    ws_wait_frame_buffer();
+
+    for(size_t value = 0; value < 256; value++)
+    {
+        float level = powf((float)value / WS_LEVEL_MAX, WS2812_GAMMA) * brightness;
+        ws_level_table[value] = (uint16_t)((level * (1 << WS_LEVEL_SHIFT)) + 0.5f);
+    }
+}
+
+#if MEASURE_LATENCY == 1
+/* Sets trace timestamp of the end of capture of the audio the frame that is being
+ * drawn was computed from. Latency is recorded when that frame is sent to the LEDs,
+ * which show it right after. Frames drawn without a new timestamp are not measured */
+void ws2812_set_frame_timestamp(uint32_t timestamp)
+{
+    ws_frame_timestamp = timestamp;
+    ws_frame_timestamp_valid = true;
+}
+#endif
+
+#if WS2812_STREAMING_ENCODER == 1
+/* Number of times SPI went idle in the middle of a frame
+ * because the next chunk wasn't encoded in time */
+uint32_t ws2812_get_underruns(void)
+{
+    return ws_underruns;
+}
+#endif
+
+#if MEASURE_PERFORMANCE == 1
+ws2818_res_t measure_ws2812_performance(cyhal_timer_t* timer_obj)
+{
+    led_color_t colors[WS_BENCHMARK_LEDS];
+    uint8_t reference[WS_ENCODED_PIXEL_SIZE];
+    uint8_t encoded[WS_ENCODED_PIXEL_SIZE];
+
+    /* Check that lookup table encoding is bit exact with the per-bit encoder */
+    for(size_t value = 0; value < 256; value++)
+    {
+        uint8_t red = value;
+        uint8_t green = value + 85;
+        uint8_t blue = value + 170;
+
+        ws_encode_pixel(encoded, red, green, blue);
+        ws_encode_pixel_per_bit(reference, red, green, blue);
+
+        if(0 != memcmp(reference, encoded, WS_ENCODED_PIXEL_SIZE))
+        {
+            printf("ws2812 encoder mismatch for value %u\r\n", (unsigned)value);
+            return ws2812_error_generic;
+        }
+    }
+
+    /* Generate some colors to encode */
+    for(size_t i = 0; i < WS_BENCHMARK_LEDS; i++)
+    {
+        colors[i].r = i;
+        colors[i].g = i * 3;
+        colors[i].b = i * 7;
     }
 
+    /* Print to make results standout */
+    printf("\r\n\n");
+    printf("###################### ws2812 performance testing results #####################\r\n");
+    printf("\r\nEncoder\t\tduration (us) for %u LEDs\r\n", WS_BENCHMARK_LEDS);
+
+    /* Per-bit encoder */
+    cyhal_timer_stop(timer_obj);
+    cyhal_timer_reset(timer_obj);
+    cyhal_timer_start(timer_obj);
+    for(size_t i = 0; i < WS_BENCHMARK_LEDS; i++)
+    {
+#if WS2812_STREAMING_ENCODER == 1
+        uint8_t* dst = &ws_streams[0].chunks[0][WS_ZERO_OFFSET + ((i % WS2812_STREAM_CHUNK_LEDS) * WS_ENCODED_PIXEL_SIZE)];
+#else
+        uint8_t* dst = ws_led_address(ws_frame_buffer, i);
+#endif
+        ws_encode_pixel_per_bit(dst, colors[i].r, colors[i].g, colors[i].b);
+    }
+    printf("per-bit\t\t%lu\r\n", (unsigned long)cyhal_timer_read(timer_obj));
+
+    /* Per LED API */
+    cyhal_timer_stop(timer_obj);
+    cyhal_timer_reset(timer_obj);
+    cyhal_timer_start(timer_obj);
+    for(size_t i = 0; i < WS_BENCHMARK_LEDS; i++)
+    {
+        ws2812_set_led(i, colors[i].r, colors[i].g, colors[i].b);
+    }
+    printf("set_led\t\t%lu\r\n", (unsigned long)cyhal_timer_read(timer_obj));
+
+    /* Bulk API */
+    cyhal_timer_stop(timer_obj);
+    cyhal_timer_reset(timer_obj);
+    cyhal_timer_start(timer_obj);
+    ws2812_set_leds(colors, 0, WS_BENCHMARK_LEDS);
+    printf("set_leds\t%lu\r\n", (unsigned long)cyhal_timer_read(timer_obj));
+
+#if WS2812_STREAMING_ENCODER == 1
+    /* Chunk encoding done from SPI IRQ, it has to be faster than the transfer
+     * which takes WS_ENCODED_PIXEL_SIZE * 8 bits per LED at WS_SPI_FREQUENCY */
+    ws_stream_t* stream = &ws_streams[0];
+    stream->next_led = 0;
+    stream->end_led = WS_BENCHMARK_LEDS;
+    cyhal_timer_stop(timer_obj);
+    cyhal_timer_reset(timer_obj);
+    cyhal_timer_start(timer_obj);
+    while(stream->next_led < stream->end_led)
+    {
+        ws_stream_fill(stream, 0, 0);
+    }
+    printf("stream\t\t%lu\r\n", (unsigned long)cyhal_timer_read(timer_obj));
+    printf("SPI transfer\t%lu\r\n",
+           (unsigned long)(((uint64_t)WS_BENCHMARK_LEDS * WS_ENCODED_PIXEL_SIZE * 8 * 1000000) / WS_SPI_FREQUENCY));
+#endif
+
+    /* Print to make results standout */
+    printf("\r\n###############################################################################\r\n");
+    printf("\r\n\n");
+
     return ws2812_success;
 }
+#endif
+
+/* Argument is the index of the strip which completed */
+static void ws_spi_event_handler(void* arg, cyhal_spi_event_t event)
+{
+    if(0u != (event & CYHAL_SPI_IRQ_DONE))
+    {
+#if WS2812_STREAMING_ENCODER == 1
+        size_t strip = (size_t)arg;
+        ws_stream_t* stream = &ws_streams[strip];
+        uint8_t sent_chunk = stream->sending;
+        uint8_t next_chunk = sent_chunk ^ 1;
+
+        if(0 != stream->chunk_length[next_chunk])
+        {
+            /* Keep SPI busy first, then encode the next chunk in place of the sent one */
+            cy_rslt_t cy_res = cyhal_spi_transfer_async(&ws_spi_handles[strip], stream->chunks[next_chunk],
+                                                        stream->chunk_length[next_chunk], NULL, 0);
+            if(CY_RSLT_SUCCESS == cy_res)
+            {
+                stream->sending = next_chunk;
+                ws_stream_fill(stream, sent_chunk, 0);
+
+                /* Transfer completed before encoding, line was idle for a while */
+                if((0 != stream->chunk_length[sent_chunk]) && !cyhal_spi_is_busy(&ws_spi_handles[strip]))
+                {
+                    ws_underruns++;
+#if MEASURE_PERFORMANCE == 1
+                    trace_event(TRACE_ID_LEDS_UNDERRUN, strip);
+#endif
+                }
+                return;
+            }
+        }
+#else
+        (void)arg;
+#endif
+
+        /* Strips may have different SPI IRQ priorities */
+        uint32_t critical_section = cyhal_system_critical_section_enter();
+        bool idle = (0 == --ws_pending_strips);
+        cyhal_system_critical_section_exit(critical_section);
+        if(!idle)
+        {
+            return;
+        }
+        ws_transfer_active = false;
+
+#if MEASURE_LATENCY == 1
+        if(ws_front_timestamp_valid)
+        {
+            latency_record(trace_get_timestamp() - ws_front_timestamp);
+        }
+#endif
+#if MEASURE_PERFORMANCE == 1
+        trace_event(TRACE_ID_LEDS_TRANSFER_DONE, 0);
+#endif
+        BaseType_t yield_required = pdFALSE;
+        xSemaphoreGiveFromISR(ws_idle_semaphore, &yield_required);
+        portYIELD_FROM_ISR(yield_required);
+    }
+}
+
+/* Maps logical LED index to its pixel in the given frame buffer */
+static inline uint8_t* ws_led_address(uint8_t* buffer, uint16_t led)
+{
+    return &buffer[((led / WS2812_STRIP_LEDS) * WS_STRIP_FRAME_SIZE) + WS_PIXELS_OFFSET +
+                   ((led % WS2812_STRIP_LEDS) * WS_BYTES_PER_PIXEL)];
+}
+
+/* Copies already encoded pixels to the back buffer, splitting
+ * the copy where it crosses strip boundary */
+static void ws_copy_pixels(uint16_t first, const uint8_t* pixels, uint16_t count)
+{
+    while(count > 0)
+    {
+        uint16_t chunk = WS2812_STRIP_LEDS - (first % WS2812_STRIP_LEDS);
+        if(chunk > count)
+        {
+            chunk = count;
+        }
+
+        memcpy(ws_led_address(ws_frame_buffer, first), pixels, chunk * WS_BYTES_PER_PIXEL);
+
+        pixels += chunk * WS_BYTES_PER_PIXEL;
+        first += chunk;
+        count -= chunk;
+    }
+}
+
+/* Waits until the frame buffer can be written. Streaming encoder
+ * reads it until the frame is sent, double buffering doesn't have to wait */
+static inline void ws_wait_frame_buffer(void)
+{
+#if WS2812_STREAMING_ENCODER == 1
+    if(ws_transfer_active)
+    {
+        ws2812_wait_idle();
+    }
+#endif
+}
+
+#if WS2812_STREAMING_ENCODER == 1
+/* Encodes next LEDs of the strip to the chunk after offset bytes.
+ * Chunk length is zero when there is nothing left to send */
+static void ws_stream_fill(ws_stream_t* stream, uint8_t chunk, size_t offset)
+{
+    uint16_t count = stream->end_led - stream->next_led;
+    if(count > WS2812_STREAM_CHUNK_LEDS)
+    {
+        count = WS2812_STREAM_CHUNK_LEDS;
+    }
+
+    const uint8_t* pixel = ws_led_address(ws_frame_buffer, stream->next_led);
+    uint8_t* dst = &stream->chunks[chunk][offset];
+    for(size_t i = 0; i < count; i++)
+    {
+        ws_encode_color(dst, pixel[1], pixel[0], pixel[2], ws_dither(stream->next_led + i));
+        pixel += WS_BYTES_PER_PIXEL;
+        dst += WS_ENCODED_PIXEL_SIZE;
+    }
+
+    stream->next_led += count;
+    stream->chunk_length[chunk] = (0 == count) ? 0 : (offset + (count * WS_ENCODED_PIXEL_SIZE));
+}
+#endif
+
+/* Stores one LED to the frame, either encoded with the given dither
+ * fraction or as colours in GRB order for streaming encoder */
+static inline void ws_store_pixel(uint8_t* dst, uint8_t red, uint8_t green, uint8_t blue, uint8_t dither)
+{
+#if WS2812_STREAMING_ENCODER == 1
+    (void)dither;
+    dst[0] = green;
+    dst[1] = red;
+    dst[2] = blue;
+#else
+    ws_encode_color(dst, red, green, blue, dither);
+#endif
+}
+
+/* Fraction added to the levels of the LED in current frame.
+ * Neighbour LEDs are one step apart so they don't flicker together */
+static inline uint8_t ws_dither(uint16_t led)
+{
+#if WS2812_DITHERING == 1
+    return ws_dither_table[(uint8_t)(ws_dither_frame + led) % WS_DITHER_STEPS];
+#else
+    (void)led;
+    return WS_ROUNDING;
+#endif
+}
+
+/* Encodes one LED with gamma and brightness applied. Level table tops
+ * at 255.0 so adding dither fraction never exceeds the code table */
+static inline void ws_encode_color(uint8_t* dst, uint8_t red, uint8_t green, uint8_t blue, uint8_t dither)
+{
+    ws_encode_codes(dst, ws_code_table[(ws_level_table[green] + dither) >> WS_LEVEL_SHIFT],
+                    ws_code_table[(ws_level_table[red] + dither) >> WS_LEVEL_SHIFT],
+                    ws_code_table[(ws_level_table[blue] + dither) >> WS_LEVEL_SHIFT]);
+}
+
+/* Encodes one LED without any correction */
+static inline void ws_encode_pixel(uint8_t* dst, uint8_t red, uint8_t green, uint8_t blue)
+{
+    ws_encode_codes(dst, ws_code_table[green], ws_code_table[red], ws_code_table[blue]);
+}
+
+/* Writes codes of one LED as 9 bytes of SPI data.
+ * WS2812 expects green then red then blue colours for the LED,
+ * 72 bits are written as two words and one byte */
+static inline void ws_encode_codes(uint8_t* dst, uint32_t green_code, uint32_t red_code, uint32_t blue_code)
+{
+    /* SPI sends MSB first, so bytes are reversed on little endian core */
+    __UNALIGNED_UINT32_WRITE(&dst[0], __REV((green_code << 8) | (red_code >> 16)));
+    __UNALIGNED_UINT32_WRITE(&dst[4], __REV((red_code << 16) | (blue_code >> 8)));
+    dst[8] = (uint8_t)blue_code;
+}
+
+#if MEASURE_PERFORMANCE == 1
+/* Reference encoder. Lookup table is used instead, this one is kept
+ * only to check that table is correct and to compare performance */
+static void ws_encode_pixel_per_bit(uint8_t* dst, uint8_t red, uint8_t green, uint8_t blue)
+{
+    uint32_t code;
+
+    code = ws_convert_3_code(green);
+    dst[0] = code >> 16;
+    dst[1] = code >> 8;
+    dst[2] = code;
+
+    code = ws_convert_3_code(red);
+    dst[3] = code >> 16;
+    dst[4] = code >> 8;
+    dst[5] = code;
+
+    code = ws_convert_3_code(blue);
+    dst[6] = code >> 16;
+    dst[7] = code >> 8;
+    dst[8] = code;
+}
 
 /* This function takes an 8-bit value representing a color
  * and turns it into a WS2812 bit code... where 1=110 and 0=011
@@ -155,3 +791,4 @@ static uint32_t ws_convert_3_code(uint8_t input)
 
     return ret_val;
 }
+#endif
@@ -4,6 +4,13 @@
 #include "app_config.h"
 #include "cyhal.h"
 
+/* Size of one stored LED, SPI data or just colours for streaming encoder */
+#if WS2812_STREAMING_ENCODER == 1
+#define WS2812_BYTES_PER_PIXEL  (3)
+#else
+#define WS2812_BYTES_PER_PIXEL  (9)
+#endif
+
 typedef enum
 {
     ws2812_success,
@@ -17,10 +24,47 @@ typedef struct {
     uint8_t b;
 } led_color_t;
 
-ws2818_res_t ws2812_init(cyhal_gpio_t mosi, cyhal_gpio_t miso, cyhal_gpio_t sclk);
+/* Order in which ring pixels are written to the LEDs */
+typedef enum
+{
+    ws2812_ring_newest_first,
+    ws2812_ring_newest_last
+} ws2812_ring_order_t;
+
+/* Size of pixel storage of a ring of length LEDs */
+#define WS2812_RING_SIZE(length)    ((length) * WS2812_BYTES_PER_PIXEL)
+
+/* Ring of already encoded pixels. Pushing a pixel encodes only
+ * that pixel and drops the oldest one, so moving patterns
+ * don't need to re-encode the whole strip every frame.
+ * Pixels are stored in the buffer given to ws2812_ring_init().
+ * With streaming encoder pixels are stored as colours */
+typedef struct {
+    uint8_t* pixels;
+    uint16_t length;
+    uint16_t head;
+    ws2812_ring_order_t order;
+} ws2812_ring_t;
+
+ws2818_res_t ws2812_init(const cyhal_gpio_t* mosi_pins);
 ws2818_res_t ws2812_set_led(uint16_t led, uint8_t red, uint8_t green, uint8_t blue);
+ws2818_res_t ws2812_set_leds(const led_color_t* colors, uint16_t first, uint16_t count);
 ws2818_res_t ws2812_set_range(uint16_t start, uint16_t end, uint8_t red, uint8_t green, uint8_t blue);
 ws2818_res_t ws2812_set_all_leds(uint8_t red, uint8_t green, uint8_t blue);
+ws2818_res_t ws2812_ring_init(ws2812_ring_t* ring, uint8_t* pixels, uint16_t length, ws2812_ring_order_t order);
+void ws2812_ring_push(ws2812_ring_t* ring, uint8_t red, uint8_t green, uint8_t blue);
+ws2818_res_t ws2812_set_ring(const ws2812_ring_t* ring, uint16_t first);
 ws2818_res_t ws2812_update(void);
+void ws2812_wait_idle(void);
+void ws2812_set_brightness(uint8_t brightness);
+#if MEASURE_LATENCY == 1
+void ws2812_set_frame_timestamp(uint32_t timestamp);
+#endif
+#if WS2812_STREAMING_ENCODER == 1
+uint32_t ws2812_get_underruns(void);
+#endif
+#if MEASURE_PERFORMANCE == 1
+ws2818_res_t measure_ws2812_performance(cyhal_timer_t* timer_obj);
+#endif
 
 #endif /* __WS2812_H__ */
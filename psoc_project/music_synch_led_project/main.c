@@ -14,11 +14,41 @@
 #include "ws2812.h"
 #include "fft_wrapper.h"
 #include "audio_visualizer.h"
+#include "audio_capture.h"
+#include "trace.h"
+#include "spectrum_pool.h"
+#include "frame_scheduler.h"
+#include "sliding_dft.h"
+#include "beat_detector.h"
+#if MEASURE_LATENCY == 1
+#include "latency.h"
+#endif
+#if BASS_ANALYSIS == 1
+#include "decimator.h"
+#endif
+
+/* Defines for analysis task, it computes spectrum of every audio window.
+ * It has higher priority than render task to keep up with audio capture */
+#define ANALYSIS_TASK_NAME          ("Analysis task")
+#define ANALYSIS_TASK_STACK_SIZE    (2 * 1024)
+#define ANALYSIS_TASK_PRIORITY      (5)
+
+/* Defines for render task, it turns spectra into LED frames and sends them */
+#define RENDER_TASK_NAME            ("Render task")
+#define RENDER_TASK_STACK_SIZE      (1024)
+#define RENDER_TASK_PRIORITY        (4)
+
+/* Defines for trace report task, it runs only when nothing else is ready */
+#define TRACE_REPORT_TASK_NAME          ("Trace report")
+#define TRACE_REPORT_TASK_STACK_SIZE    (2 * 1024)
+#define TRACE_REPORT_TASK_PRIORITY      (1)
 
-/* Defines for blinky LEDs task */
-#define BLINKY_LEDS_TASK_NAME       ("Blinky LEDs task")
-#define BLINKY_LEDS_TASK_STACK_SIZE (2 * 1024)
-#define BLINKY_LEDS_TASK_PRIORITY   (5)
+/* Maximum number of tasks shown in run time stats */
+#define TRACE_REPORT_TASKS_MAX          (8)
+
+/* Capture timestamps kept to match capture and render events of the same frame.
+ * Power of 2 larger than number of frames in the pipeline */
+#define TRACE_REPORT_FRAMES_MAX         (8)
 
 /* Macro to convert sample rate to sample period in nanoseconds */
 #define SAMPLE_RATE_TO_PERIOD_NS(hz)  ((uint32_t)(((float)1000000000) / ((float)(hz))))
@@ -42,7 +72,7 @@ static const cyhal_adc_config_t adc_cfg = {
     .average_count = 1,             /* Averaging is disabled */
     .vref = CYHAL_ADC_REF_INTERNAL, /* CYHAL_ADC_REF_INTERNAL is 1.2V */
     .vneg = CYHAL_ADC_VNEG_VSSA,
-    .resolution = 12u,
+    .resolution = AUDIO_SAMPLE_BITS,
     .ext_vref = NC,
     .bypass_pin = NC
 };
@@ -54,7 +84,8 @@ static const cyhal_adc_channel_config_t adc_chan_cfg = {
     .enabled = true                 /* Sample this channel when ADC performs a scan */
 };
 
-/* Timer is used to measure performance */
+/* Timer is used to measure performance, after start it runs
+ * freely and timestamps trace events */
 static cyhal_timer_t timer_obj;
 
 /* Timer config */
@@ -67,36 +98,94 @@ static cyhal_timer_cfg_t timer_cfg = {
     .value = 0
 };
 
-/* CMSIS DSP library FFT object */
-arm_rfft_fast_instance_f32 fft_obj;
+#if BASS_ANALYSIS == 1
+/* Low-pass filter and window of decimated audio */
+static decimator_t bass_decimator;
+
+/* DC of decimated audio, it is tracked separately from full rate audio */
+static fft_dc_tracker_t bass_dc_tracker;
+
+/* Work buffer is shared by both FFTs */
+#define FFT_WORK_BUFFER_SIZE    ((FFT_MAX_SIZE > BASS_FFT_SIZE) ? FFT_WORK_SIZE(FFT_MAX_SIZE) : FFT_WORK_SIZE(BASS_FFT_SIZE))
+#else
+#define FFT_WORK_BUFFER_SIZE    (FFT_WORK_SIZE(FFT_MAX_SIZE))
+#endif
 
-/* Semaphore for synchronization between task and IRQ */
-static SemaphoreHandle_t audio_sampling_semaphore = NULL;
+/* Bins of the three bands used by RGB modes, updated with every block */
+static sliding_dft_t rgb_sliding_dft;
 
-/* Buffer for audio signal */
-/* It need to be 2 * FFT_SIZE because while one part of the buffer is
- * processed other part is getting written ADC */
-static int32_t audio_buffer[FFT_SIZE * 2];
+/* Onsets and tempo from spectral flux of every analysed window */
+static beat_detector_t beat_detector;
 
-/* FFT result will have length of FFT_SIZE_HALF, but fft wrapper
- * internally uses result buffer for temporary conversions/results
- * to save some space so result buffer must have same size as input buffer.
- * Only first half of the buffer will contain meaningful data, other half
- * will have "garbage" data.
- */
-static float fft_res[FFT_SIZE];
+/* Overlapping windows are read straight from the capture ring
+ * and converted to the FFT engine input in this buffer.
+ * Performance measurement borrows it for every engine, so then
+ * it is sized for the largest one */
+static union {
+    fft_work_t analysis[FFT_WORK_BUFFER_SIZE];
+#if MEASURE_PERFORMANCE == 1
+    fft_measure_work_t measure[FFT_MEASURE_WORK_SIZE(FFT_MAX_SIZE)];
+#endif
+} fft_work;
+
+/* DC offset of the ADC removed from every window */
+static fft_dc_tracker_t fft_dc_tracker;
+
+/* Handles for pipeline tasks */
+static TaskHandle_t analysis_task_handle;
+static TaskHandle_t render_task_handle;
+
+#if MEASURE_PERFORMANCE == 1
+/* Handle for trace report task */
+static TaskHandle_t trace_report_task_handle;
+
+/* Pipeline stages measured from trace events */
+typedef enum
+{
+    TRACE_STAGE_CAPTURE_WAIT,
+    TRACE_STAGE_ANALYSIS,
+    TRACE_STAGE_VISUALIZATION,
+    TRACE_STAGE_LATENCY,
+    TRACE_STAGE_LEDS_TRANSFER,
+    TRACE_STAGE_MAX
+} trace_stage_t;
+
+static const char* const trace_stage_names[TRACE_STAGE_MAX] = {
+    "Capture wait",
+    "Analysis",
+    "Visualization",
+    "Latency",
+    "LEDs transfer"
+};
 
-/* Handle for LEDs task */
-static TaskHandle_t led_task_handle;
+/* Durations of every stage over the report period */
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint32_t sum;
+    uint32_t count;
+} trace_stage_stats_t;
+#endif
 
 /* Used to change visualization modes in runtime */
 volatile visualization_mode_t visualization_mode = VISUALIZATION_MODE_SNAKE_FLOW_BIDIRECTIONAL;
 
-void blinky_leds_task(void* arg);
-static void adc_event_handler(void* arg, cyhal_adc_event_t event);
+/* Used to change FFT size in runtime, from FFT_MIN_SIZE to FFT_MAX_SIZE */
+volatile size_t analysis_fft_size = FFT_SIZE;
+
+/* Tick count of the last button press */
+static TickType_t button_press_tick;
+
+void analysis_task(void* arg);
+void render_task(void* arg);
 static cy_rslt_t app_init(void);
 static cy_rslt_t adc_init(void);
 static void switch_mode_interrupt_handler(void* handler_arg, cyhal_gpio_event_t event);
+static void merge_bins(size_t* first_bin, size_t* bins_count, size_t other_first_bin, size_t other_bins_count);
+#if MEASURE_PERFORMANCE == 1
+void trace_report_task(void* arg);
+static void trace_stage_add(trace_stage_stats_t* stats, uint32_t duration);
+#endif
 
 /* Callback data for the user button */
 cyhal_gpio_callback_data_t gpio_callback_data = {
@@ -135,17 +224,35 @@ int main(void)
 
     /* Measure FFT performance before starting RToS to get more accurate results */
 #if MEASURE_PERFORMANCE == 1
+    /* Analysis buffers are not used until tasks start, so measurement borrows them */
     arm_status arm_res;
-    arm_res = measure_fft_performance(&timer_obj);
+    spectrum_slot_t* ref_slot = spectrum_pool_acquire();
+    spectrum_slot_t* res_slot = spectrum_pool_acquire();
+    arm_res = measure_fft_performance(&timer_obj, fft_work.measure, ref_slot->fft_res, res_slot->fft_res);
     ASSERT_WITH_PRINT(ARM_MATH_SUCCESS == arm_res, "measure_fft_performance failed!\r\n");
+    spectrum_pool_release(ref_slot);
+    spectrum_pool_release(res_slot);
+
+    ws2818_res_t ws_res;
+    ws_res = measure_ws2812_performance(&timer_obj);
+    ASSERT_WITH_PRINT(ws2812_success == ws_res, "measure_ws2812_performance failed!\r\n");
 #endif
 
-    /* Create semaphore */
-    audio_sampling_semaphore = xSemaphoreCreateBinary();
+    /* Timer runs freely from now on, it timestamps trace events and FreeRTOS run time stats */
+    trace_res_t trace_res = trace_init(&timer_obj);
+    ASSERT_WITH_PRINT(trace_success == trace_res, "trace_init failed!\r\n");
 
     /* Create FreeRTOS task */
-    rtos_res = xTaskCreate(blinky_leds_task, BLINKY_LEDS_TASK_NAME, BLINKY_LEDS_TASK_STACK_SIZE, NULL, BLINKY_LEDS_TASK_PRIORITY, &led_task_handle);
-    ASSERT_WITH_PRINT(pdPASS == rtos_res, "%s didn't started!\r\n", BLINKY_LEDS_TASK_NAME);
+    rtos_res = xTaskCreate(analysis_task, ANALYSIS_TASK_NAME, ANALYSIS_TASK_STACK_SIZE, NULL, ANALYSIS_TASK_PRIORITY, &analysis_task_handle);
+    ASSERT_WITH_PRINT(pdPASS == rtos_res, "%s didn't started!\r\n", ANALYSIS_TASK_NAME);
+
+    rtos_res = xTaskCreate(render_task, RENDER_TASK_NAME, RENDER_TASK_STACK_SIZE, NULL, RENDER_TASK_PRIORITY, &render_task_handle);
+    ASSERT_WITH_PRINT(pdPASS == rtos_res, "%s didn't started!\r\n", RENDER_TASK_NAME);
+
+#if MEASURE_PERFORMANCE == 1
+    rtos_res = xTaskCreate(trace_report_task, TRACE_REPORT_TASK_NAME, TRACE_REPORT_TASK_STACK_SIZE, NULL, TRACE_REPORT_TASK_PRIORITY, &trace_report_task_handle);
+    ASSERT_WITH_PRINT(pdPASS == rtos_res, "%s didn't started!\r\n", TRACE_REPORT_TASK_NAME);
+#endif
 
     vTaskStartScheduler();
 
@@ -155,81 +262,451 @@ int main(void)
     }
 }
 
-void blinky_leds_task(void* arg)
+/* First stage of the pipeline. Waits for audio, computes spectrum
+ * to a pool slot and passes it to render task. FFT of the next window
+ * runs while render task draws and sends the previous one */
+void analysis_task(void* arg)
+{
+    (void)arg;
+    audio_capture_res_t capture_res;
+    int16_t* audio_block;
+    const int16_t* window_head;
+    const int16_t* window_tail;
+    size_t window_head_length;
+    size_t first_bin;
+    size_t bins_count;
+    uint16_t frame = 0;
+    uint32_t active_needs = 0;
+    size_t fft_size = FFT_SIZE;
+    fft_instance_t* fft_plan = fft_get_plan(FFT_SIZE);
+#if BASS_ANALYSIS == 1
+    fft_instance_t* bass_fft_plan = fft_get_plan(BASS_FFT_SIZE);
+#endif
+
+    /* Start continuous audio capture, it runs in background from now on */
+    capture_res = audio_capture_start();
+    ASSERT_WITH_PRINT(audio_capture_success == capture_res, "audio_capture_start failed!\r\n");
+
+    printf("%s started!\r\n", ANALYSIS_TASK_NAME);
+
+    for(;;)
+    {
+#if MEASURE_PERFORMANCE == 1
+        trace_event(TRACE_ID_FRAME_START, frame);
+#endif
+
+        /* Wait until DMA fills the next block of samples */
+        capture_res = audio_capture_get_block(&audio_block);
+        ASSERT_WITH_PRINT(audio_capture_success == capture_res, "audio_capture_get_block failed!\r\n");
+
+#if MEASURE_PERFORMANCE == 1
+        trace_event(TRACE_ID_CAPTURE_DONE, frame);
+#endif
+
+        /* Mode may be changed from IRQ, so it is read once per frame
+         * and passed to render task together with products computed for it */
+        visualization_mode_t mode = visualization_mode;
+        uint32_t needs = visualize_get_needs(mode);
+
+        /* Products the previous mode didn't use were not kept up to date */
+        uint32_t started_needs = needs & ~active_needs;
+        active_needs = needs;
+
+        /* Sliding DFT has to see every sample, it starts over from silence when
+         * mode needs it again and is in sync after SLIDING_DFT_WINDOW_SIZE samples */
+        if(0 != (needs & VISUALIZE_NEEDS_TRACKED_BINS))
+        {
+            if(0 != (started_needs & VISUALIZE_NEEDS_TRACKED_BINS))
+            {
+                sliding_dft_reset(&rgb_sliding_dft);
+            }
+            sliding_dft_process(&rgb_sliding_dft, audio_block, AUDIO_CAPTURE_BLOCK_SIZE);
+        }
+
+        /* FFT size may be changed from IRQ too. All sizes are initialized at start,
+         * so switching is only a lookup and the frame is not delayed */
+        if(analysis_fft_size != fft_size)
+        {
+            fft_size = analysis_fft_size;
+            fft_plan = fft_get_plan(fft_size);
+            ASSERT_WITH_PRINT(NULL != fft_plan, "fft_get_plan failed!\r\n");
+
+            /* Detector starts over with bins of the new size */
+            beat_detector_res_t beat_res = beat_detector_set_fft_size(&beat_detector, fft_size, AUDIO_SAMPLING_RATE);
+            ASSERT_WITH_PRINT(beat_detector_success == beat_res, "beat_detector_set_fft_size failed!\r\n");
+        }
+
+        /* Flux against spectrum of a different mode's frame would be a false onset */
+        if(0 != (started_needs & VISUALIZE_NEEDS_BEAT))
+        {
+            beat_detector_reset(&beat_detector);
+        }
+
+#if BASS_ANALYSIS == 1
+        /* Every block is decimated once, so bass window is updated at the same hop */
+        if(0 != (needs & VISUALIZE_NEEDS_BASS_SPECTRUM))
+        {
+            if(0 != (started_needs & VISUALIZE_NEEDS_BASS_SPECTRUM))
+            {
+                decimator_reset(&bass_decimator);
+            }
+            decimator_process(&bass_decimator, audio_block);
+        }
+#endif
+
+        /* Every block brings AUDIO_HOP_SIZE new samples, FFT is computed over
+         * the latest fft_size samples so consecutive windows overlap */
+        capture_res = audio_capture_get_window(fft_size, &window_head, &window_head_length, &window_tail);
+        if(audio_capture_error_not_enough_samples == capture_res)
+        {
+            /* Keep the block and wait for the next one until first window is filled,
+             * also after switch to a longer FFT */
+            continue;
+        }
+        ASSERT_WITH_PRINT(audio_capture_success == capture_res, "audio_capture_get_window failed!\r\n");
+
+#if BASS_ANALYSIS == 1
+        const int16_t* bass_head;
+        const int16_t* bass_tail;
+        size_t bass_head_length;
+        bool bass_ready = false;
+
+        /* Bass window is longer in time than the full rate one, so it is filled later.
+         * Until then bass bins are silent rather than holding frames back */
+        if(0 != (needs & VISUALIZE_NEEDS_BASS_SPECTRUM))
+        {
+            bass_ready = (decimator_success == decimator_get_window(&bass_decimator, &bass_head, &bass_head_length,
+                                                                    &bass_tail));
+        }
+#endif
+
+        /* Slot is always available, oldest queued spectrum is dropped if render task is behind */
+        spectrum_slot_t* slot = spectrum_pool_acquire();
+
+        slot->mode = mode;
+        slot->frame = frame;
+#if MEASURE_LATENCY == 1
+        slot->capture_timestamp = audio_capture_get_block_timestamp();
+#endif
+
+        if(0 != (needs & VISUALIZE_NEEDS_TRACKED_BINS))
+        {
+            /* Bins are already up to date, only their power is needed */
+            sliding_dft_get_power(&rgb_sliding_dft, slot->fft_res);
+            slot->spectrum_size = rgb_sliding_dft.bins_count;
+        }
+        else if(0 != (needs & (VISUALIZE_NEEDS_SPECTRUM | VISUALIZE_NEEDS_BEAT)))
+        {
+            /* Calculate FFT, only bins used by visualization and beat detector */
+            visualize_get_bins(slot->mode, fft_size / 2, &first_bin, &bins_count);
+            if(0 != (needs & VISUALIZE_NEEDS_BEAT))
+            {
+                size_t beat_first_bin;
+                size_t beat_bins_count;
+                beat_detector_get_bins(&beat_detector, &beat_first_bin, &beat_bins_count);
+                merge_bins(&first_bin, &bins_count, beat_first_bin, beat_bins_count);
+            }
+
+            compute_rfft_split(fft_plan, window_head, window_head_length, window_tail, &fft_dc_tracker,
+                               fft_work.analysis, slot->fft_res, fft_size, first_bin, bins_count);
+            slot->spectrum_size = fft_size / 2;
+
+            if(0 != (needs & VISUALIZE_NEEDS_BEAT))
+            {
+                beat_detector_process(&beat_detector, slot->fft_res, &slot->beat);
+            }
+        }
+        else
+        {
+            slot->spectrum_size = 0;
+        }
+
+        /* Oldest block is not part of the next window, give it back to DMA.
+         * After switch to a shorter FFT there are more of them */
+        audio_capture_release_blocks(fft_size);
+
+#if BASS_ANALYSIS == 1
+        visualize_get_bass_bins(slot->mode, &first_bin, &bins_count);
+        if(bass_ready && (0 != bins_count))
+        {
+            compute_rfft_split(bass_fft_plan, bass_head, bass_head_length, bass_tail, &bass_dc_tracker,
+                               fft_work.analysis, slot->bass_res, BASS_FFT_SIZE, first_bin, bins_count);
+        }
+        else if(0 != bins_count)
+        {
+            arm_fill_f32(0, &slot->bass_res[first_bin], bins_count);
+        }
+#endif
+
+#if MEASURE_PERFORMANCE == 1
+        trace_event(TRACE_ID_FFT_DONE, frame);
+#endif
+
+        spectrum_pool_submit(slot);
+        frame++;
+    }
+}
+
+/* Second stage of the pipeline. Renders spectra to the LEDs at FRAME_RATE_FPS,
+ * SPI transfer of the frame runs in background while the next spectrum is computed */
+void render_task(void* arg)
 {
     (void)arg;
     ws2818_res_t ws_res;
-    cy_rslt_t cy_res;
-    /* While one part of the buffer is processed other part is getting written ADC
-     * then they are swapped */
-    uint8_t active_adc_buffer = 0;
-    uint8_t active_uart_buffer = (active_adc_buffer + 1) % 2;
+    frame_scheduler_res_t scheduler_res;
+    spectrum_slot_t* slot = NULL;
+    static const cyhal_gpio_t ws2812_strip_pins[WS2812_STRIPS_COUNT] = WS2812_STRIP_PINS;
 
     /* TODO: ws2812_init() ideally should be in app_init() but for some reasons
      * when it is called from app_init() SPI transfer complete interrupt is never raised.
      * This is probably some freeRTOS specific thing */
     /* Initialize ws2812 library */
-    /* MISO and SCLK are not needed so they are not connected (NC) */
-    ws_res = ws2812_init(WS2812_LEDS_PIN, NC, NC);
+    ws_res = ws2812_init(ws2812_strip_pins);
     ASSERT_WITH_PRINT(ws2812_success == ws_res, "ws2812_init failed\r\n");
 
-    printf("%s started!\r\n", BLINKY_LEDS_TASK_NAME);
+    scheduler_res = frame_scheduler_init(FRAME_RATE_FPS);
+    ASSERT_WITH_PRINT(frame_scheduler_success == scheduler_res, "frame_scheduler_init failed\r\n");
+
+    printf("%s started!\r\n", RENDER_TASK_NAME);
 
     for(;;)
     {
+        frame_scheduler_wait();
+
+        /* The latest spectrum is kept until a newer one arrives, so a frame
+         * whose analysis is late draws the previous spectrum instead of waiting */
+        spectrum_slot_t* latest = spectrum_pool_receive_latest();
+        if(NULL != latest)
+        {
+            if(NULL != slot)
+            {
+                spectrum_pool_release(slot);
+            }
+            slot = latest;
+        }
+        else if(NULL != slot)
+        {
+            frame_scheduler_count_stale();
+        }
+        else
+        {
+            /* Nothing analysed yet */
+            continue;
+        }
+
 #if MEASURE_PERFORMANCE == 1
-        cyhal_timer_stop(&timer_obj);
-        cyhal_timer_reset(&timer_obj);
-        cyhal_timer_start(&timer_obj);
+        trace_event(TRACE_ID_RENDER_START, slot->frame);
 #endif
 
-        cy_res = cyhal_adc_read_async(&adc_obj, FFT_SIZE, &audio_buffer[FFT_SIZE * active_adc_buffer]);
-        ASSERT_WITH_PRINT(CY_RSLT_SUCCESS == cy_res, "cyhal_adc_read_async failed!\r\n");
-
-#if MEASURE_PERFORMANCE == 1
-        uint32_t red_async_duration = cyhal_timer_read(&timer_obj);
+#if MEASURE_LATENCY == 1
+        /* Only the first frame drawn from a spectrum is measured,
+         * redrawn ones would count the same audio again */
+        if(NULL != latest)
+        {
+            ws2812_set_frame_timestamp(slot->capture_timestamp);
+        }
 #endif
 
-        /* Calculate FFT */
-        compute_rfft(&fft_obj, &audio_buffer[FFT_SIZE * active_uart_buffer], fft_res, FFT_SIZE);
+        /* Visualize FFT */
+#if BASS_ANALYSIS == 1
+        visualize_fft(slot->fft_res, slot->spectrum_size, slot->bass_res, &slot->beat, slot->mode);
+#else
+        visualize_fft(slot->fft_res, slot->spectrum_size, NULL, &slot->beat, slot->mode);
+#endif
 
 #if MEASURE_PERFORMANCE == 1
-        uint32_t fft_duration = cyhal_timer_read(&timer_obj) - red_async_duration;
+        trace_event(TRACE_ID_VISUALIZATION_DONE, slot->frame);
 #endif
-        /* Visualize FFT */
-        /* TODO: Visualization has low FPS when MEASURE_PERFORMANCE is 0.
-         * Adding delay instead of printf() does not help. I believe that this is
-         * RToS related problem, but need to check and fix this issue.
-         */
-        /* TODO: implement mode switching */
-        visualize_fft(fft_res, FFT_SIZE_HALF, visualization_mode);
-
-        /* Swap buffers */
-        uint8_t swap_tmp = active_uart_buffer;
-        active_uart_buffer = active_adc_buffer;
-        active_adc_buffer = swap_tmp;
+    }
+}
 
 #if MEASURE_PERFORMANCE == 1
-        uint32_t visualization_duration = cyhal_timer_read(&timer_obj) - fft_duration;
+/* Turns trace events into per stage timings and prints them together
+ * with FreeRTOS run time stats once per TRACE_REPORT_PERIOD_MS.
+ * Printing happens here, so the measured pipeline is not slowed down by UART */
+void trace_report_task(void* arg)
+{
+    (void)arg;
+    static trace_event_t events[TRACE_BUFFER_EVENTS];
+    static trace_stage_stats_t stages[TRACE_STAGE_MAX];
+    static TaskStatus_t tasks[TRACE_REPORT_TASKS_MAX];
+    static uint32_t capture_timestamps[TRACE_REPORT_FRAMES_MAX];
+    spectrum_pool_stats_t pool_stats;
+    frame_scheduler_stats_t scheduler_stats;
+#if MEASURE_LATENCY == 1
+    latency_stats_t latency_stats;
 #endif
+    uint32_t analysis_stage_start = 0;
+    uint32_t render_start = 0;
+    uint32_t transfer_start = 0;
+    bool analysis_started = false;
+    bool render_started = false;
+    bool transfer_started = false;
+    TickType_t last_wake_time = xTaskGetTickCount();
 
-        /* Semaphore will be released in ADC IRQ once cyhal_adc_read_async completes */
-        xSemaphoreTake(audio_sampling_semaphore, portMAX_DELAY);
+    for(;;)
+    {
+        uint32_t frames = 0;
+        uint32_t audio_blocks = 0;
+        size_t events_count;
+
+        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(TRACE_REPORT_PERIOD_MS));
+
+        for(size_t i = 0; i < TRACE_STAGE_MAX; i++)
+        {
+            stages[i].min = UINT32_MAX;
+            stages[i].max = 0;
+            stages[i].sum = 0;
+            stages[i].count = 0;
+        }
+
+        /* Stage duration is the time between two consecutive events of a pipeline stage */
+        while(0 != (events_count = trace_read(events, TRACE_BUFFER_EVENTS)))
+        {
+            for(size_t i = 0; i < events_count; i++)
+            {
+                uint32_t timestamp = events[i].timestamp;
+
+                switch (events[i].id)
+                {
+                case TRACE_ID_FRAME_START:
+                    analysis_stage_start = timestamp;
+                    analysis_started = true;
+                    break;
+                case TRACE_ID_CAPTURE_DONE:
+                    if(analysis_started)
+                    {
+                        trace_stage_add(&stages[TRACE_STAGE_CAPTURE_WAIT], timestamp - analysis_stage_start);
+                        capture_timestamps[events[i].arg % TRACE_REPORT_FRAMES_MAX] = timestamp;
+                        analysis_stage_start = timestamp;
+                    }
+                    break;
+                case TRACE_ID_FFT_DONE:
+                    if(analysis_started)
+                    {
+                        trace_stage_add(&stages[TRACE_STAGE_ANALYSIS], timestamp - analysis_stage_start);
+                        analysis_started = false;
+                    }
+                    break;
+                case TRACE_ID_RENDER_START:
+                    render_start = timestamp;
+                    render_started = true;
+                    break;
+                case TRACE_ID_VISUALIZATION_DONE:
+                    if(render_started)
+                    {
+                        /* Latency is from the moment audio window was ready to LED frame being queued */
+                        trace_stage_add(&stages[TRACE_STAGE_VISUALIZATION], timestamp - render_start);
+                        trace_stage_add(&stages[TRACE_STAGE_LATENCY],
+                                        timestamp - capture_timestamps[events[i].arg % TRACE_REPORT_FRAMES_MAX]);
+                        render_started = false;
+                        frames++;
+                    }
+                    break;
+                case TRACE_ID_AUDIO_BLOCK:
+                    audio_blocks++;
+                    break;
+                case TRACE_ID_LEDS_TRANSFER_START:
+                    transfer_start = timestamp;
+                    transfer_started = true;
+                    break;
+                case TRACE_ID_LEDS_TRANSFER_DONE:
+                    if(transfer_started)
+                    {
+                        trace_stage_add(&stages[TRACE_STAGE_LEDS_TRANSFER], timestamp - transfer_start);
+                        transfer_started = false;
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+
+        printf("\r\nPerformance measurements (us):\r\n");
+        printf("Stage           min       avg       max\r\n");
+        for(size_t i = 0; i < TRACE_STAGE_MAX; i++)
+        {
+            if(0 == stages[i].count)
+            {
+                continue;
+            }
+
+            printf("%-15s %-9lu %-9lu %lu\r\n", trace_stage_names[i], stages[i].min,
+                   stages[i].sum / stages[i].count, stages[i].max);
+        }
+        printf("Frames          %lu\r\n", frames);
+
+#if MEASURE_LATENCY == 1
+        /* Audio to light latency since start, from capture of the audio to the end of LED transfer */
+        latency_get_stats(&latency_stats);
+        if(0 != latency_stats.count)
+        {
+            printf("Audio to light  p50 %lu us, p95 %lu us, p99 %lu us, max %lu us\r\n",
+                   latency_stats.p50, latency_stats.p95, latency_stats.p99, latency_stats.max);
+            if(0 != latency_stats.overflows)
+            {
+                printf("Over range      %lu\r\n", latency_stats.overflows);
+            }
+        }
+#endif
 
-#if MEASURE_PERFORMANCE == 1
-        uint32_t semaphore_wait_duration = cyhal_timer_read(&timer_obj) - visualization_duration;
-        cyhal_timer_stop(&timer_obj);
-
-        printf("\r\nPerformance measurements:\r\n");
-        printf("ADC read async  %lu\r\n", red_async_duration);
-        printf("FFT             %lu\r\n", fft_duration);
-        printf("Visualization   %lu\r\n", visualization_duration);
-        printf("Semaphore take  %lu\r\n", semaphore_wait_duration);
-        printf("Total           %lu\r\n", semaphore_wait_duration + fft_duration + visualization_duration + red_async_duration);
+        /* Output rate against FRAME_RATE_FPS deadlines */
+        frame_scheduler_get_stats(&scheduler_stats);
+        printf("Frame rate      %lu fps (target %u)\r\n",
+               (scheduler_stats.frames * 1000) / TRACE_REPORT_PERIOD_MS, FRAME_RATE_FPS);
+        printf("Stale frames    %lu\r\n", scheduler_stats.stale_frames);
+        printf("Missed frames   %lu\r\n", scheduler_stats.missed_deadlines);
+        if(0 != scheduler_stats.jitter_count)
+        {
+            printf("Frame jitter    %lu us avg, %lu us max\r\n",
+                   scheduler_stats.jitter_sum / scheduler_stats.jitter_count, scheduler_stats.jitter_max);
+        }
+        printf("Audio blocks    %lu\r\n", audio_blocks);
+        printf("Overruns        %lu\r\n", audio_capture_get_overruns());
+
+#if WS2812_STREAMING_ENCODER == 1
+        printf("LED underruns   %lu\r\n", ws2812_get_underruns());
 #endif
+        printf("Dropped events  %lu\r\n", trace_get_dropped());
+
+        /* Spectra that were waiting for render task and ones dropped because it was behind */
+        spectrum_pool_get_stats(&pool_stats);
+        printf("Render queue    %lu (max %lu)\r\n", pool_stats.ready_depth, pool_stats.ready_depth_max);
+        printf("Render drops    %lu\r\n", pool_stats.drops);
+
+        /* Share of CPU time of every task since start */
+        uint32_t total_run_time;
+        UBaseType_t tasks_count = uxTaskGetSystemState(tasks, TRACE_REPORT_TASKS_MAX, &total_run_time);
+        total_run_time /= 100;
+        if(0 != total_run_time)
+        {
+            printf("\r\nTask            CPU\r\n");
+            for(size_t i = 0; i < tasks_count; i++)
+            {
+                printf("%-15s %lu%%\r\n", tasks[i].pcTaskName, tasks[i].ulRunTimeCounter / total_run_time);
+            }
+        }
     }
 }
 
+static void trace_stage_add(trace_stage_stats_t* stats, uint32_t duration)
+{
+    if(duration < stats->min)
+    {
+        stats->min = duration;
+    }
+
+    if(duration > stats->max)
+    {
+        stats->max = duration;
+    }
+
+    stats->sum += duration;
+    stats->count++;
+}
+#endif
+
 static cy_rslt_t app_init(void)
 {
     cy_rslt_t cy_res;
@@ -262,15 +739,51 @@ static cy_rslt_t app_init(void)
 
     /* Configure GPIO interrupt */
     cyhal_gpio_register_callback(CYBSP_USER_BTN, &gpio_callback_data);
-    cyhal_gpio_enable_event(CYBSP_USER_BTN, CYHAL_GPIO_IRQ_FALL, 7, true);
+    cyhal_gpio_enable_event(CYBSP_USER_BTN, CYHAL_GPIO_IRQ_BOTH, 7, true);
 
-    /* Initialize FFT instance for CMSIS DSP library */
-    arm_res = arm_rfft_fast_init_f32(&fft_obj, FFT_SIZE);
+    /* Initialize FFT instances of all supported sizes for CMSIS DSP library,
+     * including the one for bass analysis */
+    arm_res = fft_plans_init();
     if(ARM_MATH_SUCCESS != arm_res)
     {
         return (!CY_RSLT_SUCCESS);
     }
 
+    /* Initialize sliding DFT with the bins used by RGB modes */
+    uint16_t tracked_bins[SLIDING_DFT_MAX_BINS];
+    size_t tracked_bins_count = visualize_get_tracked_bins(FFT_SIZE_HALF, tracked_bins, SLIDING_DFT_MAX_BINS);
+    if(sliding_dft_success != sliding_dft_init(&rgb_sliding_dft, tracked_bins, tracked_bins_count))
+    {
+        return (!CY_RSLT_SUCCESS);
+    }
+
+    /* Initialize beat detector, it is updated once per analysis window */
+    if(beat_detector_success != beat_detector_init(&beat_detector, FFT_SIZE, AUDIO_SAMPLING_RATE,
+                                                   (float)AUDIO_SAMPLING_RATE / AUDIO_HOP_SIZE))
+    {
+        return (!CY_RSLT_SUCCESS);
+    }
+
+#if BASS_ANALYSIS == 1
+    /* Initialize low-pass filter for bass analysis */
+    if(decimator_success != decimator_init(&bass_decimator))
+    {
+        return (!CY_RSLT_SUCCESS);
+    }
+#endif
+
+    /* Initialize pool of spectra passed between pipeline tasks */
+    if(spectrum_pool_success != spectrum_pool_init())
+    {
+        return (!CY_RSLT_SUCCESS);
+    }
+
+    /* Initialize visualizer */
+    if(visualizer_success != visualize_init(AUDIO_SAMPLING_RATE))
+    {
+        return (!CY_RSLT_SUCCESS);
+    }
+
     return CY_RSLT_SUCCESS;
 }
 
@@ -300,38 +813,66 @@ static cy_rslt_t adc_init(void)
         return cy_res;
     }
 
-    /* Register adc callback function */
-    cyhal_adc_register_callback(&adc_obj, &adc_event_handler, NULL);
-
-    /* Subscribe to the async read complete event */
-    cyhal_adc_enable_event(&adc_obj, CYHAL_ADC_ASYNC_READ_COMPLETE, CYHAL_ISR_PRIORITY_DEFAULT, true);
-
-    /* TODO: Use DMA for cyhal_adc_read_async */
-    // cy_res = cyhal_adc_set_async_mode(&adc_obj, CYHAL_ASYNC_DMA, 3);
-    // if(CY_RSLT_SUCCESS != cy_res)
-    // {
-    //     return cy_res;
-    // }
+    /* Initialize audio capture ring */
+    if(audio_capture_success != audio_capture_init(&adc_chan_obj))
+    {
+        return (!CY_RSLT_SUCCESS);
+    }
 
     return CY_RSLT_SUCCESS;
 }
 
-static void adc_event_handler(void* arg, cyhal_adc_event_t event)
+void switch_mode_interrupt_handler(void* handler_arg, cyhal_gpio_event_t event)
 {
-    (void)arg;
-    if(0u != (event & CYHAL_ADC_ASYNC_READ_COMPLETE))
+    (void)handler_arg;
+    (void)event;
+
+    /* Interrupt comes on both edges, action is taken on release
+     * when the length of the press is known */
+    if(CYBSP_BTN_PRESSED == cyhal_gpio_read(CYBSP_USER_BTN))
     {
-        BaseType_t yield_required = pdFALSE;
-        xSemaphoreGiveFromISR(audio_sampling_semaphore, &yield_required);
-        portYIELD_FROM_ISR(yield_required);
+        button_press_tick = xTaskGetTickCountFromISR();
+        return;
+    }
+
+    TickType_t press_ticks = xTaskGetTickCountFromISR() - button_press_tick;
+
+    /* Contact bounce, the press is still going on */
+    if(press_ticks < pdMS_TO_TICKS(BUTTON_DEBOUNCE_MS))
+    {
+        return;
+    }
+
+    if(press_ticks >= pdMS_TO_TICKS(BUTTON_LONG_PRESS_MS))
+    {
+        /* Cycle through the FFT sizes */
+        analysis_fft_size = (analysis_fft_size < FFT_MAX_SIZE) ? (analysis_fft_size * 2) : FFT_MIN_SIZE;
+    }
+    else
+    {
+        /* Cycle through the visualization modes */
+        visualization_mode = (visualization_mode + 1) % VISUALIZATION_MODE_MAX;
     }
 }
 
-void switch_mode_interrupt_handler(void* handler_arg, cyhal_gpio_event_t event)
+/* Extends bin range to cover the other one too, empty ranges are ignored */
+static void merge_bins(size_t* first_bin, size_t* bins_count, size_t other_first_bin, size_t other_bins_count)
 {
-    (void)handler_arg;
-    (void)event;
+    if(0 == other_bins_count)
+    {
+        return;
+    }
+
+    if(0 == *bins_count)
+    {
+        *first_bin = other_first_bin;
+        *bins_count = other_bins_count;
+        return;
+    }
+
+    size_t end_bin = *first_bin + *bins_count;
+    size_t other_end_bin = other_first_bin + other_bins_count;
 
-    /* Cycle through the visualization modes */
-    visualization_mode = (visualization_mode + 1) % VISUALIZATION_MODE_MAX;
+    *first_bin = (other_first_bin < *first_bin) ? other_first_bin : *first_bin;
+    *bins_count = ((other_end_bin > end_bin) ? other_end_bin : end_bin) - *first_bin;
 }